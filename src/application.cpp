@@ -39,6 +39,7 @@
 #include "ui/mainwindow.h"
 #include "util/crashpad.h"
 #include "util/fatalerror.h"
+#include "util/networkmanager.h"
 #include "util/oauthmanager.h"
 #include "util/repoe.h"
 #include "util/updatechecker.h"
@@ -55,8 +56,8 @@
 Application::Application(const QDir& appDataDir) {
     QLOG_DEBUG() << "Application: created";
 
-    QLOG_TRACE() << "Application: creating QNetworkAccessManager";
-    m_network_manager = std::make_unique<QNetworkAccessManager>();
+    QLOG_TRACE() << "Application: creating NetworkManager";
+    m_network_manager = std::make_unique<NetworkManager>();
 
     QLOG_TRACE() << "Application: creating RePoE";
     m_repoe = std::make_unique<RePoE>(network_manager());
@@ -81,6 +82,9 @@ void Application::InitUserDir(const QString& dir) {
     QLOG_TRACE() << "Application: opening global data file:" << global_data_file;
     m_global_data = std::make_unique<SqliteDataStore>(global_data_file);
 
+    const QString network_cache_dir = dir + QDir::separator() + "network_cache";
+    m_network_manager->SetCacheDirectory(network_cache_dir);
+
     const QString image_cache_dir = dir + QDir::separator() + "cache";
     m_image_cache = std::make_unique<ImageCache>(network_manager(), image_cache_dir);
 
@@ -172,10 +176,13 @@ void Application::OnLogin(POE_API api) {
     connect(m_main_window.get(), &MainWindow::SetTheme, this, &Application::SetTheme);
     connect(m_main_window.get(), &MainWindow::UpdateCheckRequested, m_update_checker.get(), &UpdateChecker::CheckForUpdates);
 
+    connect(m_items_manager.get(), &ItemsManager::ItemsAboutToRefresh, m_main_window.get(), &MainWindow::OnItemsAboutToRefresh);
     connect(m_items_manager.get(), &ItemsManager::ItemsRefreshed, m_main_window.get(), &MainWindow::OnItemsRefreshed);
     connect(m_items_manager.get(), &ItemsManager::StatusUpdate, m_main_window.get(), &MainWindow::OnStatusUpdate);
 
-    connect(m_main_window.get(), &MainWindow::GetImage, m_image_cache.get(), &ImageCache::fetch);
+    connect(m_main_window.get(), &MainWindow::GetImage, m_image_cache.get(), qOverload<const QString&>(&ImageCache::fetch));
+    connect(m_main_window.get(), &MainWindow::PrefetchImages, m_image_cache.get(), &ImageCache::prefetch);
+    connect(m_main_window.get(), &MainWindow::WarmUpImages, m_image_cache.get(), &ImageCache::warmUp);
     connect(m_image_cache.get(), &ImageCache::imageReady, m_main_window.get(), &MainWindow::OnImageFetched);
 
     connect(m_shop.get(), &Shop::StatusUpdate, m_main_window.get(), &MainWindow::OnStatusUpdate);
@@ -420,7 +427,8 @@ void Application::InitLogin(POE_API mode)
     QLOG_TRACE() << "Application::InitLogin() creating rate limiter";
     m_rate_limiter = std::make_unique<RateLimiter>(
         network_manager(),
-        oauth_manager(), mode);
+        oauth_manager(),
+        data(), mode);
 
     QLOG_TRACE() << "Application::InitLogin() creating buyout manager";
     m_buyout_manager = std::make_unique<BuyoutManager>(
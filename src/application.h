@@ -37,6 +37,7 @@ class ImageCache;
 class ItemsManager;
 class LoginDialog;
 class MainWindow;
+class NetworkManager;
 class OAuthManager;
 class RateLimiter;
 class RePoE;
@@ -80,7 +81,7 @@ private:
     void InitCrashReporting();
     void SaveDbOnNewVersion();
 
-    std::unique_ptr<QNetworkAccessManager> m_network_manager;
+    std::unique_ptr<NetworkManager> m_network_manager;
     std::unique_ptr<QSettings> m_settings;
 
     std::unique_ptr<RePoE> m_repoe;
@@ -19,8 +19,42 @@
 
 #include "bucket.h"
 
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
 #include "util/fatalerror.h"
 
+namespace {
+
+    // Buckets with fewer items than this per thread are sorted on one thread.
+    constexpr size_t MIN_ITEMS_PER_THREAD = 4096;
+
+    // Calls task(0) to task(count - 1) on the global thread pool, running
+    // task(0) on the calling thread, and returns once all of them are done.
+    template <typename Task>
+    void RunParallel(int count, const Task& task) {
+        QSemaphore done;
+        for (int i = 1; i < count; ++i) {
+            QThreadPool::globalInstance()->start([&task, &done, i]() {
+                task(i);
+                done.release();
+            });
+        };
+        if (count > 0) {
+            task(0);
+        };
+        if (count > 1) {
+            done.acquire(count - 1);
+        };
+    }
+
+}
+
 Bucket::Bucket(const ItemLocation& location)
     : m_location(location)
 {}
@@ -52,16 +86,77 @@ const std::shared_ptr<Item>& Bucket::item(int row) const
     return m_items[row];
 }
 
-void Bucket::Sort(const Column& column, Qt::SortOrder order)
+void Bucket::Sort(const Column& column, Qt::SortOrder order, int threads)
 {
-    std::sort(begin(m_items), end(m_items),
-        [&](const std::shared_ptr<Item>& lhs, const std::shared_ptr<Item>& rhs)
-        {
-            if (order == Qt::AscendingOrder) {
-                return column.lt(rhs.get(), lhs.get());
-            } else {
-                return column.lt(lhs.get(), rhs.get());
-            };
-        }
-    );
+    const size_t count = m_items.size();
+    if (count < 2) {
+        return;
+    };
+
+    // Split the items into one chunk per thread.
+    const size_t max_chunks = std::max<size_t>(1, count / MIN_ITEMS_PER_THREAD);
+    const int chunks = static_cast<int>(std::min<size_t>(std::max(threads, 1), max_chunks));
+    const auto chunk_begin = [&](int chunk) { return count * chunk / chunks; };
+
+    // Work out what each item is sorted by once, instead of on every comparison.
+    std::vector<Column::SortKey> keys(count);
+    RunParallel(chunks, [&](int chunk) {
+        for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+            keys[i] = column.sort_key(*m_items[i]);
+        };
+    });
+
+    // Sort the item positions rather than the items themselves.
+    const auto less = [&](size_t lhs, size_t rhs) {
+        if (order == Qt::AscendingOrder) {
+            std::swap(lhs, rhs);
+        };
+        if (keys[lhs] < keys[rhs]) {
+            return true;
+        } else if (keys[rhs] < keys[lhs]) {
+            return false;
+        };
+        return *m_items[lhs] < *m_items[rhs];
+    };
+    std::vector<size_t> positions(count);
+    std::iota(positions.begin(), positions.end(), size_t(0));
+    const auto position = [&](int chunk) { return positions.begin() + chunk_begin(chunk); };
+
+    // Sort each chunk, then merge neighbouring runs until there is only one.
+    RunParallel(chunks, [&](int chunk) {
+        std::sort(position(chunk), position(chunk + 1), less);
+    });
+    for (int width = 1; width < chunks; width *= 2) {
+        const int merges = (chunks + width - 1) / (2 * width);
+        RunParallel(merges, [&](int merge) {
+            const int first = 2 * width * merge;
+            const int middle = first + width;
+            const int last = std::min(middle + width, chunks);
+            std::inplace_merge(position(first), position(middle), position(last), less);
+        });
+    };
+
+    Items sorted;
+    sorted.reserve(count);
+    for (const auto i : positions) {
+        sorted.push_back(std::move(m_items[i]));
+    };
+    m_items.swap(sorted);
+}
+
+void Bucket::SortAll(std::vector<Bucket>& buckets, const Column& column, Qt::SortOrder order)
+{
+    const int threads = std::max(QThread::idealThreadCount(), 1);
+    if (buckets.size() == 1) {
+        buckets.front().Sort(column, order, threads);
+        return;
+    };
+
+    // Each thread takes the next unsorted bucket until there are none left.
+    std::atomic<size_t> next(0);
+    RunParallel(static_cast<int>(std::min<size_t>(threads, buckets.size())), [&](int) {
+        for (size_t i = next++; i < buckets.size(); i = next++) {
+            buckets[i].Sort(column, order);
+        };
+    });
 }
@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "item.h"
 #include "itemlocation.h"
 #include "column.h"
@@ -40,11 +42,15 @@ public:
 
     void AddItem(const std::shared_ptr<Item>& item);
     void AddItems(const Items& items);
+    void Reserve(size_t count) { m_items.reserve(count); }
     const Items& items() const { return m_items; }
     bool has_item(int row) const;
     const std::shared_ptr<Item>& item(int row) const;
     const ItemLocation& location() const { return m_location; }
-    void Sort(const Column& column, Qt::SortOrder order);
+    // Sorts the items using up to the given number of threads.
+    void Sort(const Column& column, Qt::SortOrder order, int threads = 1);
+    // Sorts all the buckets, several at a time.
+    static void SortAll(std::vector<Bucket>& buckets, const Column& column, Qt::SortOrder order);
 
 private:
     Items m_items;
@@ -42,6 +42,7 @@ const std::map<QString, BuyoutType> BuyoutManager::m_string_to_buyout_type = {
 BuyoutManager::BuyoutManager(DataStore& data)
     : m_data(data)
     , m_save_needed(false)
+    , m_generation(0)
 {
     Load();
 }
@@ -59,10 +60,12 @@ void BuyoutManager::Set(const Item& item, const Buyout& buyout) {
         // Entry exists - we don't want to update if buyout is equal to existing
         if (buyout != it->second) {
             m_save_needed = true;
+            ++m_generation;
             it->second = buyout;
         };
     } else {
         m_save_needed = true;
+        ++m_generation;
         m_buyouts[item.hash()] = buyout;
     };
 }
@@ -100,10 +103,12 @@ void BuyoutManager::SetTab(const QString& tab, const Buyout& buyout) {
         // Entry exists - we don't want to update if buyout is equal to existing
         if (buyout != it->second) {
             m_save_needed = true;
+            ++m_generation;
             it->second = buyout;
         };
     } else {
         m_save_needed = true;
+        ++m_generation;
         m_tab_buyouts[tab] = buyout;
     };
 }
@@ -119,6 +124,7 @@ void BuyoutManager::CompressTabBuyouts() {
     for (auto it = m_tab_buyouts.begin(), ite = m_tab_buyouts.end(); it != ite;) {
         if (tmp.count(it->first) == 0) {
             m_save_needed = true;
+            ++m_generation;
             it = m_tab_buyouts.erase(it);
         } else {
             ++it;
@@ -138,6 +144,7 @@ void BuyoutManager::CompressItemBuyouts(const Items& items) {
 
     for (auto it = m_buyouts.cbegin(); it != m_buyouts.cend();) {
         if (tmp.count(it->first) == 0) {
+            ++m_generation;
             m_buyouts.erase(it++);
         } else {
             ++it;
@@ -170,6 +177,7 @@ void BuyoutManager::ClearRefreshLocks() {
 
 void BuyoutManager::Clear() {
     m_save_needed = true;
+    ++m_generation;
     m_buyouts.clear();
     m_tab_buyouts.clear();
     m_refresh_locked.clear();
@@ -303,6 +311,7 @@ void BuyoutManager::Load() {
     Deserialize(m_data.Get("buyouts"), &m_buyouts);
     Deserialize(m_data.Get("tab_buyouts"), &m_tab_buyouts);
     Deserialize(m_data.Get("refresh_checked_state"), m_refresh_checked);
+    ++m_generation;
 }
 void BuyoutManager::SetStashTabLocations(const std::vector<ItemLocation>& tabs) {
     m_tabs = tabs;
@@ -348,5 +357,6 @@ void BuyoutManager::MigrateItem(const Item& item) {
         m_buyouts[hash] = it->second;
         m_buyouts.erase(it);
         m_save_needed = true;
+        ++m_generation;
     };
 }
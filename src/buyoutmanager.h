@@ -60,6 +60,9 @@ public:
     void Load();
 
     void MigrateItem(const Item& item);
+
+    // Increases whenever an item or tab buyout changes.
+    quint64 generation() const { return m_generation; }
 private:
     BuyoutType StringToBuyoutType(QString bo_str) const;
 
@@ -75,6 +78,7 @@ private:
     std::map<QString, bool> m_refresh_checked;
     std::set<QString> m_refresh_locked;
     bool m_save_needed;
+    quint64 m_generation;
     std::vector<ItemLocation> m_tabs;
     static const std::map<QString, BuyoutType> m_string_to_buyout_type;
 };
@@ -20,6 +20,7 @@
 #include "column.h"
 
 #include <cmath>
+#include <limits>
 #include <QVector>
 #include <QRegularExpression>
 #include <QApplication>
@@ -32,6 +33,9 @@
 #include "influence.h"
 #include "itemconstants.h"
 
+// This is several screens of rows.
+constexpr qsizetype MAX_CACHED_ROWS = 4096;
+
 const double EPS = 1e-6;
 const char* SORT_DOUBLE_MATCH = "^\\+?([\\d.]+)%?$";
 const char* SORT_TWO_VALUES = "^(\\d+)([-/])(\\d+)$";
@@ -40,44 +44,32 @@ QColor Column::color(const Item& /* item */) const {
     return QApplication::palette().color(QPalette::WindowText);
 }
 
-Column::sort_tuple Column::multivalue(const Item* item) const {
+Column::SortKey Column::sort_key(const Item& item) const {
 
     // Transform values into something optimal for sorting
     // Possibilities: 12, 12.12, 10%, 10.13%, +16%, 12-14, 10/20
     static const QRegularExpression sort_double_match(SORT_DOUBLE_MATCH);
     static const QRegularExpression sort_two_values(SORT_TWO_VALUES);
 
-    double first_double = 0.0;
-    double second_double = 0.0;
-    QString first_string = "";
-    QString second_string = "";
+    SortKey key;
 
-    QString str = value(*item).toString();
+    QString str = value(item).toString();
     QRegularExpressionMatch match;
 
     if (str.contains(sort_double_match, &match)) {
-        first_double = match.captured(1).toDouble();
+        key.first_double = match.captured(1).toDouble();
     } else if (str.contains(sort_two_values, &match)) {
         if (match.captured(2).startsWith("-")) {
-            first_double = 0.5 * (match.captured(1).toDouble() + match.captured(3).toDouble());
+            key.first_double = 0.5 * (match.captured(1).toDouble() + match.captured(3).toDouble());
         } else {
-            first_string = item->PrettyName();
-            second_double = match.captured(1).toDouble();
+            key.first_string = item.PrettyName();
+            key.second_double = match.captured(1).toDouble();
         }
     } else {
-        first_string = str;
-        second_string = item->PrettyName();
+        key.first_string = str;
+        key.second_string = item.PrettyName();
     }
-
-    return std::forward_as_tuple(
-        first_double,
-        first_string,
-        second_double,
-        second_string, *item);
-}
-
-bool Column::lt(const Item* lhs, const Item* rhs) const {
-    return multivalue(lhs) < multivalue(rhs);
+    return key;
 }
 
 QString NameColumn::name() const {
@@ -348,18 +340,12 @@ QColor PriceColumn::color(const Item& item) const {
     return bo.IsInherited() ? QColor(0xaa, 0xaa, 0xaa) : QApplication::palette().color(QPalette::WindowText);
 }
 
-std::tuple<int, double, const Item&> PriceColumn::multivalue(const Item* item) const {
-    const Buyout& bo = m_bo_manager.Get(*item);
-    // forward_as_tuple used to forward item reference properly and avoid ref to temporary
-    // that will be destroyed.  We want item reference because we want to sort based on item
-    // object itself and not the pointer.  I'm not entirely sure I fully understand
-    // this mechanism, but basically want to avoid a ton of Item copies during sorting
-    // so trying to avoid pass by value (ericsium).
-    return std::forward_as_tuple(bo.currency.AsRank(), bo.value, *item);
-}
-
-bool PriceColumn::lt(const Item* lhs, const Item* rhs) const {
-    return multivalue(lhs) < multivalue(rhs);
+Column::SortKey PriceColumn::sort_key(const Item& item) const {
+    const Buyout& bo = m_bo_manager.Get(item);
+    SortKey key;
+    key.first_double = bo.currency.AsRank();
+    key.second_double = bo.value;
+    return key;
 }
 
 DateColumn::DateColumn(const BuyoutManager& bo_manager) :
@@ -375,11 +361,14 @@ QVariant DateColumn::value(const Item& item) const {
     return bo.IsActive() ? Util::TimeAgoInWords(bo.last_update) : QVariant();
 }
 
-bool DateColumn::lt(const Item* lhs, const Item* rhs) const {
-    const QDateTime lhs_update_time = m_bo_manager.Get(*lhs).last_update;
-    const QDateTime rhs_update_time = m_bo_manager.Get(*rhs).last_update;
-    return (std::tie(lhs_update_time, *lhs) <
-        std::tie(rhs_update_time, *rhs));
+Column::SortKey DateColumn::sort_key(const Item& item) const {
+    // Items without a buyout have no date and come before all the others.
+    const QDateTime last_update = m_bo_manager.Get(item).last_update;
+    SortKey key;
+    key.first_double = last_update.isValid()
+        ? static_cast<double>(last_update.toMSecsSinceEpoch())
+        : -std::numeric_limits<double>::infinity();
+    return key;
 }
 
 QString ItemlevelColumn::name() const {
@@ -391,3 +380,60 @@ QVariant ItemlevelColumn::value(const Item& item) const {
         return item.ilvl();
     return QVariant();
 }
+
+ColumnCache::ColumnCache(const BuyoutManager& bo_manager, const std::vector<std::unique_ptr<Column>>& columns)
+    : m_bo_manager(bo_manager)
+    , m_columns(columns)
+    , m_rows(MAX_CACHED_ROWS)
+    , m_buyout_generation(bo_manager.generation())
+{}
+
+QVariant ColumnCache::data(const Item& item, int column, int role) {
+    if ((column < 0) || (column >= static_cast<int>(m_columns.size()))) {
+        return QVariant();
+    };
+    const Column& col = *m_columns[column];
+    if (!col.IsCacheable()) {
+        switch (role) {
+        case Qt::DisplayRole: return col.value(item);
+        case Qt::ForegroundRole: return col.color(item);
+        case Qt::DecorationRole: return col.icon(item);
+        default: return QVariant();
+        };
+    };
+    if (m_buyout_generation != m_bo_manager.generation()) {
+        m_rows.clear();
+        m_buyout_generation = m_bo_manager.generation();
+    };
+    const Row* row = m_rows.object(&item);
+    if (!row) {
+        // Views ask for every column of a row, so fill them all at once.
+        auto new_row = new Row;
+        new_row->values.reserve(m_columns.size());
+        new_row->colors.reserve(m_columns.size());
+        new_row->icons.reserve(m_columns.size());
+        for (const auto& other : m_columns) {
+            if (other->IsCacheable()) {
+                new_row->values.push_back(other->value(item));
+                new_row->colors.push_back(other->color(item));
+                new_row->icons.push_back(other->icon(item));
+            } else {
+                new_row->values.emplace_back();
+                new_row->colors.emplace_back();
+                new_row->icons.emplace_back();
+            };
+        };
+        m_rows.insert(&item, new_row);
+        row = new_row;
+    };
+    switch (role) {
+    case Qt::DisplayRole: return row->values[column];
+    case Qt::ForegroundRole: return row->colors[column];
+    case Qt::DecorationRole: return row->icons[column];
+    default: return QVariant();
+    };
+}
+
+void ColumnCache::Clear() {
+    m_rows.clear();
+}
@@ -19,10 +19,15 @@
 
 #pragma once
 
+#include <QCache>
 #include <QColor>
 #include <QString>
 #include <QVariant>
 
+#include <memory>
+#include <tuple>
+#include <vector>
+
 #include "item.h"
 
 class BuyoutManager;
@@ -39,15 +44,29 @@ public:
     Column(Column&&) = default;
     Column& operator = (Column&&) = default;
 
+    // What an item is sorted by in this column. Items with equal keys
+    // are ordered by the items themselves.
+    struct SortKey {
+        double first_double = 0.0;
+        QString first_string;
+        double second_double = 0.0;
+        QString second_string;
+        bool operator<(const SortKey& other) const {
+            return std::tie(first_double, first_string, second_double, second_string)
+                < std::tie(other.first_double, other.first_string, other.second_double, other.second_string);
+        }
+    };
+
     virtual QString name() const = 0;
     virtual QVariant value(const Item& item) const = 0;
     virtual QVariant icon(const Item& item) const = 0;
     virtual QColor color(const Item& item) const;
-    virtual bool lt(const Item* lhs, const Item* rhs) const;
+    // This may be called from several threads at once while sorting.
+    virtual SortKey sort_key(const Item& item) const;
+    // Columns whose values change over time return false, so that they
+    // are looked up every time they are shown.
+    virtual bool IsCacheable() const { return true; };
     virtual ~Column() {}
-private:
-    typedef std::tuple<double, QString, double, QString, const Item&> sort_tuple;
-    sort_tuple multivalue(const Item* item) const;
 };
 
 class NameColumn : public Column {
@@ -152,10 +171,9 @@ public:
     QString name() const;
     QVariant value(const Item& item) const;
     QColor color(const Item& item) const;
-    bool lt(const Item* lhs, const Item* rhs) const;
+    SortKey sort_key(const Item& item) const;
     QVariant icon(const Item& item) const { Q_UNUSED(item); return QVariant::fromValue(NULL); }
 private:
-    std::tuple<int, double, const Item&> multivalue(const Item* item) const;
     const BuyoutManager& m_bo_manager;
 };
 
@@ -164,8 +182,10 @@ public:
     explicit DateColumn(const BuyoutManager& bo_manager);
     QString name() const;
     QVariant value(const Item& item) const;
-    bool lt(const Item* lhs, const Item* rhs) const;
+    SortKey sort_key(const Item& item) const;
     QVariant icon(const Item& item) const { Q_UNUSED(item); return QVariant::fromValue(NULL); }
+    // The dates are shown relative to now.
+    bool IsCacheable() const { return false; };
 private:
     const BuyoutManager& m_bo_manager;
 };
@@ -176,3 +196,25 @@ public:
     QVariant value(const Item& item) const;
     QVariant icon(const Item& item) const { Q_UNUSED(item); return QVariant::fromValue(NULL); }
 };
+
+// Remembers what the columns show for the most recently displayed items, so
+// that repainting a view doesn't look up and format every value again. The
+// prices shown come from buyouts, so everything is forgotten when any buyout
+// changes. Columns that aren't cacheable are always looked up.
+class ColumnCache {
+public:
+    ColumnCache(const BuyoutManager& bo_manager, const std::vector<std::unique_ptr<Column>>& columns);
+    QVariant data(const Item& item, int column, int role);
+    void Clear();
+private:
+    struct Row {
+        std::vector<QVariant> values;
+        std::vector<QVariant> colors;
+        std::vector<QVariant> icons;
+    };
+
+    const BuyoutManager& m_bo_manager;
+    const std::vector<std::unique_ptr<Column>>& m_columns;
+    QCache<const Item*, Row> m_rows;
+    quint64 m_buyout_generation;
+};
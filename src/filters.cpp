@@ -17,6 +17,7 @@
     along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <memory>
 #include <QAbstractItemView>
 #include <QListView>
@@ -35,6 +36,7 @@
 #include "buyoutmanager.h"
 #include "filters.h"
 #include "itemconstants.h"
+#include "itemindex.h"
 
 const QString CategorySearchFilter::k_Default = "<any>";
 const QString RaritySearchFilter::k_Default = "<any>";
@@ -58,10 +60,42 @@ FilterData::FilterData(Filter* filter)
     , m_filter(filter)
 {}
 
+void FilterStatistics::Record(size_t items, size_t matches, qint64 elapsed) {
+    // Older searches count for less each time, so the statistics
+    // follow changes in the items and in how the filter is used.
+    constexpr double decay = 0.75;
+    evaluated = (evaluated * decay) + items;
+    passed = (passed * decay) + matches;
+    nanoseconds = (nanoseconds * decay) + elapsed;
+}
+
+double FilterStatistics::Cost() const {
+    // Assume an unknown filter is about as expensive as a property lookup.
+    return (evaluated > 0.0) ? (nanoseconds / evaluated) : 100.0;
+}
+
+double FilterStatistics::PassRate() const {
+    return (evaluated > 0.0) ? (passed / evaluated) : 0.5;
+}
+
+double FilterStatistics::Rank() const {
+    // The expected time spent per item rejected.
+    const double rejected = std::max(1.0 - PassRate(), 0.001);
+    return Cost() / rejected;
+}
+
 bool FilterData::Matches(const std::shared_ptr<Item>& item) {
     return m_filter->Matches(item, this);
 }
 
+bool FilterData::FindCandidates(const ItemIndex& index, std::vector<size_t>* candidates) {
+    return m_filter->FindCandidates(this, index, candidates);
+}
+
+bool FilterData::FindBitmap(const ItemIndex& index, ItemBitmap* bitmap) {
+    return m_filter->FindBitmap(this, index, bitmap);
+}
+
 void FilterData::FromForm() {
     m_filter->FromForm(this);
 }
@@ -94,6 +128,11 @@ bool NameSearchFilter::Matches(const std::shared_ptr<Item>& item, FilterData* da
     return name.contains(query);
 }
 
+bool NameSearchFilter::FindCandidates(FilterData* data, const ItemIndex& index, std::vector<size_t>* candidates) {
+    *candidates = index.FindName(data->text_query);
+    return true;
+}
+
 void NameSearchFilter::Initialize(QLayout* parent) {
     MainWindow* main_window = qobject_cast<MainWindow*>(parent->parentWidget()->window());
     QWidget* group = new QWidget;
@@ -136,6 +175,11 @@ bool CategorySearchFilter::Matches(const std::shared_ptr<Item>& item, FilterData
     return item->category().contains(data->text_query);
 }
 
+bool CategorySearchFilter::FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap) {
+    *bitmap = index.FindCategory(data->text_query);
+    return true;
+}
+
 void CategorySearchFilter::Initialize(QLayout* parent) {
     MainWindow* main_window = qobject_cast<MainWindow*>(parent->parentWidget()->window());
     QWidget* group = new QWidget;
@@ -194,6 +238,26 @@ bool RaritySearchFilter::Matches(const std::shared_ptr<Item>& item, FilterData*
     };
 }
 
+bool RaritySearchFilter::FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap) {
+    if (data->text_query.isEmpty()) {
+        return false;
+    };
+    int frame_type = -1;
+    if (data->text_query == "Normal") {
+        frame_type = FRAME_TYPE_NORMAL;
+    } else if (data->text_query == "Magic") {
+        frame_type = FRAME_TYPE_MAGIC;
+    } else if (data->text_query == "Rare") {
+        frame_type = FRAME_TYPE_RARE;
+    } else if (data->text_query == "Unique") {
+        frame_type = FRAME_TYPE_UNIQUE;
+    } else if (data->text_query == "Unique (Relic)") {
+        frame_type = FRAME_TYPE_RELIC;
+    };
+    *bitmap = index.FindFrameType(frame_type);
+    return true;
+}
+
 void RaritySearchFilter::Initialize(QLayout* parent) {
     MainWindow* main_window = qobject_cast<MainWindow*>(parent->parentWidget()->window());
     QWidget* group = new QWidget;
@@ -475,6 +539,18 @@ bool BooleanFilter::Matches(const std::shared_ptr<Item>& /* item */, FilterData*
 }
 
 bool AltartFilter::Matches(const std::shared_ptr<Item>& item, FilterData* data) {
+    return !data->checked || IsAltart(*item);
+}
+
+bool AltartFilter::FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap) {
+    if (!data->checked) {
+        return false;
+    };
+    *bitmap = index.FindFlag(ItemIndex::Flag::Altart);
+    return true;
+}
+
+bool AltartFilter::IsAltart(const Item& item) {
     static const QStringList altart = {
         // season 1
         "RedBeak2.png", "Wanderlust2.png", "Ring2b.png", "Goldrim2.png", "FaceBreaker2.png", "Atzirismirror2.png",
@@ -517,11 +593,8 @@ bool AltartFilter::Matches(const std::shared_ptr<Item>& item, FilterData* data)
         "WinterHeart.png",
     };
 
-    if (!data->checked) {
-        return true;
-    };
     for (auto& needle : altart) {
-        if (item->icon().contains(needle)) {
+        if (item.icon().contains(needle)) {
             return true;
         };
     };
@@ -536,22 +609,62 @@ bool UnidentifiedFilter::Matches(const std::shared_ptr<Item>& item, FilterData*
     return !data->checked || !item->identified();
 }
 
+bool UnidentifiedFilter::FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap) {
+    if (!data->checked) {
+        return false;
+    };
+    *bitmap = index.FindFlag(ItemIndex::Flag::Unidentified);
+    return true;
+}
+
 bool CraftedFilter::Matches(const std::shared_ptr<Item>& item, FilterData* data) {
     return !data->checked || item->crafted();
 }
 
+bool CraftedFilter::FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap) {
+    if (!data->checked) {
+        return false;
+    };
+    *bitmap = index.FindFlag(ItemIndex::Flag::Crafted);
+    return true;
+}
+
 bool EnchantedFilter::Matches(const std::shared_ptr<Item>& item, FilterData* data) {
     return !data->checked || item->enchanted();
 }
 
+bool EnchantedFilter::FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap) {
+    if (!data->checked) {
+        return false;
+    };
+    *bitmap = index.FindFlag(ItemIndex::Flag::Enchanted);
+    return true;
+}
+
 bool InfluencedFilter::Matches(const std::shared_ptr<Item>& item, FilterData* data) {
     return !data->checked || item->hasInfluence();
 }
 
+bool InfluencedFilter::FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap) {
+    if (!data->checked) {
+        return false;
+    };
+    *bitmap = index.FindFlag(ItemIndex::Flag::Influenced);
+    return true;
+}
+
 bool CorruptedFilter::Matches(const std::shared_ptr<Item>& item, FilterData* data) {
     return !data->checked || item->corrupted();
 }
 
+bool CorruptedFilter::FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap) {
+    if (!data->checked) {
+        return false;
+    };
+    *bitmap = index.FindFlag(ItemIndex::Flag::Corrupted);
+    return true;
+}
+
 double ItemlevelFilter::GetValue(const std::shared_ptr<Item>& item) {
     return item->ilvl();
 }
@@ -23,6 +23,7 @@
 #include <memory>
 
 #include "item.h"
+#include "modlist.h"
 
 class QLineEdit;
 class QCheckBox;
@@ -33,8 +34,31 @@ class QLayout;
 
 class BuyoutManager;
 class FilterData;
+class ItemBitmap;
+class ItemIndex;
 class SearchComboBox;
 
+/*
+ * Running totals of how a filter performed in past searches. The search
+ * planner uses them to run cheap filters that reject many items first.
+ */
+struct FilterStatistics {
+    void Record(size_t items, size_t matches, qint64 elapsed);
+
+    // The average time to check one item, in nanoseconds.
+    double Cost() const;
+
+    // The fraction of checked items that matched.
+    double PassRate() const;
+
+    // Lower ranks should be checked first.
+    double Rank() const;
+
+    double evaluated{ 0.0 };
+    double passed{ 0.0 };
+    double nanoseconds{ 0.0 };
+};
+
 /*
  * Objects of subclasses of this class do the following:
  * 1) FromForm: provided with a FilterData fill it with data from form
@@ -60,11 +84,26 @@ public:
     virtual void ResetForm() = 0;
     virtual bool Matches(const std::shared_ptr<Item>& item, FilterData* data) = 0;
 
+    // Filters that can use the item index override this to look up the sorted
+    // positions of the items they match instead of checking every item. Returns
+    // false when the index can't be used, in which case Matches() is called.
+    virtual bool FindCandidates(FilterData* /* data */, const ItemIndex& /* index */, std::vector<size_t>* /* candidates */) { return false; };
+
+    // Filters on simple item attributes override this to return the matching
+    // items as a bitmap, so that they can be combined a word at a time.
+    virtual bool FindBitmap(FilterData* /* data */, const ItemIndex& /* index */, ItemBitmap* /* bitmap */) { return false; };
+
+    // Filters whose result depends on more than the item itself, such as
+    // buyouts, return false so searches don't reuse their previous results.
+    virtual bool IsCacheable() const { return true; };
+
     std::unique_ptr<FilterData> CreateData();
     bool IsActive() const { return m_active; };
+    FilterStatistics& statistics() { return m_statistics; };
 
 protected:
     bool m_active{ false };
+    FilterStatistics m_statistics;
 };
 
 struct ModFilterData {
@@ -73,12 +112,17 @@ struct ModFilterData {
         min(m_min),
         max(m_max),
         min_filled(m_min_filled),
-        max_filled(m_max_filled)
+        max_filled(m_max_filled),
+        id(GetModId(m_mod))
     {}
 
     QString mod;
     double min, max;
     bool min_filled, max_filled;
+
+    // The mod id is looked up from the name once, so that searches
+    // don't have to compare strings for every item.
+    ModId id;
 };
 
 /*
@@ -90,6 +134,8 @@ public:
     FilterData(Filter* filter);
     Filter* filter() { return m_filter; }
     bool Matches(const std::shared_ptr<Item>& item);
+    bool FindCandidates(const ItemIndex& index, std::vector<size_t>* candidates);
+    bool FindBitmap(const ItemIndex& index, ItemBitmap* bitmap);
     void FromForm();
     void ToForm();
     // Various types of data for various filters
@@ -112,6 +158,7 @@ public:
     void ToForm(FilterData* data);
     void ResetForm();
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindCandidates(FilterData* data, const ItemIndex& index, std::vector<size_t>* candidates);
     void Initialize(QLayout* parent);
 private:
     QLineEdit* m_textbox;
@@ -124,6 +171,7 @@ public:
     void ToForm(FilterData* data);
     void ResetForm();
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap);
     void Initialize(QLayout* parent);
     static const QString k_Default;
 private:
@@ -138,6 +186,7 @@ public:
     void ToForm(FilterData* data);
     void ResetForm();
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap);
     void Initialize(QLayout* parent);
     static const QString k_Default;
     static const QStringList RARITY_LIST;
@@ -273,6 +322,8 @@ public:
         BooleanFilter(parent, property, caption) {}
     using BooleanFilter::BooleanFilter;
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap);
+    static bool IsAltart(const Item& item);
 };
 
 class PricedFilter : public BooleanFilter {
@@ -282,6 +333,7 @@ public:
         m_bm(bm)
     {}
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool IsCacheable() const { return false; };
 private:
     const BuyoutManager& m_bm;
 };
@@ -292,6 +344,7 @@ public:
         BooleanFilter(parent, property, caption) {}
     using BooleanFilter::BooleanFilter;
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap);
 };
 
 class CraftedFilter : public BooleanFilter {
@@ -300,6 +353,7 @@ public:
         BooleanFilter(parent, property, caption) {}
     using BooleanFilter::BooleanFilter;
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap);
 };
 
 class EnchantedFilter : public BooleanFilter {
@@ -308,6 +362,7 @@ public:
         BooleanFilter(parent, property, caption) {}
     using BooleanFilter::BooleanFilter;
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap);
 };
 
 class InfluencedFilter : public BooleanFilter {
@@ -316,6 +371,7 @@ public:
         BooleanFilter(parent, property, caption) {}
     using BooleanFilter::BooleanFilter;
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap);
 };
 
 class CorruptedFilter : public BooleanFilter {
@@ -324,6 +380,7 @@ public:
         BooleanFilter(parent, property, caption) {}
     using BooleanFilter::BooleanFilter;
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindBitmap(FilterData* data, const ItemIndex& index, ItemBitmap* bitmap);
 };
 
 class ItemlevelFilter : public MinMaxFilter {
@@ -20,74 +20,277 @@
 #include "imagecache.h"
 
 #include <QDir>
+#include <QDirIterator>
 #include <QFile>
 #include <QImageReader>
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QString>
-#include <QCryptographicHash>
 
-#include <QsLog/QsLog.h>
+#include <algorithm>
 
-#include "util/util.h"
+#include <QsLog/QsLog.h>
 
+#include "imagepack.h"
 #include "network_info.h"
 
+// Item images are small, so this is enough for thousands of them.
+constexpr qsizetype MAX_CACHED_IMAGE_BYTES = 64 * 1024 * 1024;
+constexpr int MAX_DECODE_THREADS = 2;
+constexpr int MAX_DOWNLOADS = 4;
+
 ImageCache::ImageCache(
     QNetworkAccessManager& network_manager,
     const QString& directory)
     : m_network_manager(network_manager)
     , m_directory(directory)
+    , m_lru_bytes(0)
+    , m_importing(false)
+    , m_active_downloads(0)
 {
     if (!QDir(m_directory).exists()) {
         QDir().mkpath(m_directory);
     };
+    m_decode_pool.setMaxThreadCount(MAX_DECODE_THREADS);
+
+    m_pack = std::make_unique<ImagePack>(m_directory + QDir::separator() + "images.pack");
+
+    // Compacting and importing rewrite a lot of data, so they are done in the
+    // background, while the pack is still in use.
+    const bool compact = (m_pack->garbage() > m_pack->size() / 2);
+    const bool import = QDirIterator(m_directory, { "*.png" }, QDir::Files).hasNext();
+    if (compact || import) {
+        m_importing = import;
+        m_decode_pool.start([this, compact, import]() {
+            if (compact) {
+                m_pack->Compact();
+            };
+            if (import) {
+                const int count = m_pack->Import(m_directory);
+                QLOG_INFO() << "ImageCache: moved" << count << "images into the image pack";
+                m_importing = false;
+            };
+            });
+    };
+}
+
+ImageCache::~ImageCache() {
+    // Decoding tasks post their results back to this object.
+    m_decode_pool.clear();
+    m_decode_pool.waitForDone();
 }
 
 bool ImageCache::contains(const QString& url) const {
-    const QString filename = getImagePath(url);
-    const QFile file(filename);
-    return file.exists();
+    if (m_lru_index.count(url) > 0) {
+        return true;
+    };
+    const QByteArray key = getKey(url);
+    if (m_pack->contains(key)) {
+        return true;
+    };
+    return m_importing && QFile::exists(getImagePath(key));
 }
 
 void ImageCache::fetch(const QString& url) {
-    if (contains(url)) {
-        QLOG_DEBUG() << "ImageCache: already contains" << url;
+    fetch(url, Priority::Display);
+}
+
+void ImageCache::prefetch(const QStringList& urls) {
+    for (const auto& url : urls) {
+        if (m_lru_index.count(url) == 0) {
+            fetch(url, Priority::Prefetch);
+        };
+    };
+}
+
+void ImageCache::warmUp(const QStringList& urls) {
+    int count = 0;
+    for (const auto& url : urls) {
+        if (!contains(url)) {
+            download(url, Priority::WarmUp);
+            ++count;
+        };
+    };
+    QLOG_DEBUG() << "ImageCache: warming up" << count << "images";
+}
+
+void ImageCache::fetch(const QString& url, Priority priority) {
+    if (m_lru_index.count(url) > 0) {
+        QLOG_DEBUG() << "ImageCache: already loaded" << url;
         emit imageReady(url);
+    } else if (contains(url)) {
+        QLOG_DEBUG() << "ImageCache: already contains" << url;
+        decode(url, priority);
     } else {
-        QLOG_DEBUG() << "ImageCache: fetching" << url;
-        QNetworkRequest request = QNetworkRequest(QUrl(url));
-        request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
-        QNetworkReply* reply = m_network_manager.get(request);
-        connect(reply, &QNetworkReply::finished, this, &ImageCache::onFetched);
+        download(url, priority);
     };
 }
 
+std::deque<QString>& ImageCache::queue(Priority priority) {
+    return m_queues[static_cast<int>(priority)];
+}
+
+void ImageCache::download(const QString& url, Priority priority) {
+    const auto it = m_downloading.find(url);
+    if (it == m_downloading.end()) {
+        m_downloading.insert(url, priority);
+        queue(priority).push_back(url);
+    } else if (priority > it.value()) {
+        // The image is already on its way, but it may need to move up the queue.
+        auto& old_queue = queue(it.value());
+        const auto pos = std::find(old_queue.begin(), old_queue.end(), url);
+        if (pos != old_queue.end()) {
+            old_queue.erase(pos);
+            queue(priority).push_back(url);
+        };
+        it.value() = priority;
+    };
+    startDownloads();
+}
+
+void ImageCache::startDownloads() {
+    for (int i = static_cast<int>(Priority::Display); i >= 0; --i) {
+        const Priority priority = static_cast<Priority>(i);
+        auto& pending = queue(priority);
+        while (!pending.empty() && (m_active_downloads < MAX_DOWNLOADS)) {
+            const QString url = pending.front();
+            pending.pop_front();
+
+            QLOG_DEBUG() << "ImageCache: fetching" << url;
+            QNetworkRequest request = QNetworkRequest(QUrl(url));
+            request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
+            // Images are saved by this class, so there's no need to keep them in the network cache, too.
+            request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+            if (priority != Priority::Display) {
+                request.setPriority(QNetworkRequest::LowPriority);
+            };
+            // Keep the original url, because the reply url changes on redirects.
+            request.setAttribute(QNetworkRequest::User, url);
+            QNetworkReply* reply = m_network_manager.get(request);
+            connect(reply, &QNetworkReply::finished, this, &ImageCache::onFetched);
+            ++m_active_downloads;
+        };
+    };
+}
+
+void ImageCache::decode(const QString& url, Priority priority) {
+    if (m_decoding.contains(url)) {
+        return;
+    };
+    m_decoding.insert(url);
+    const QByteArray key = getKey(url);
+    m_decode_pool.start([this, url, key]() {
+        const QImage image = QImage::fromData(read(key));
+        QMetaObject::invokeMethod(this, [this, url, image]() { onDecoded(url, image); }, Qt::QueuedConnection);
+        }, static_cast<int>(priority));
+}
+
+void ImageCache::onDecoded(const QString& url, const QImage& image) {
+    m_decoding.remove(url);
+    if (image.isNull()) {
+        // Forget the image so that it can be downloaded again.
+        QLOG_WARN() << "ImageCache: unable to decode" << url;
+        m_pack->remove(getKey(url));
+        return;
+    };
+    insert(url, image);
+    emit imageReady(url);
+}
+
 void ImageCache::onFetched() {
     QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-    const QString url = reply->url().toString();
+    reply->deleteLater();
+    const QString url = reply->request().attribute(QNetworkRequest::User).toString();
+    --m_active_downloads;
+    startDownloads();
+
     if (reply->error() != QNetworkReply::NoError) {
         QLOG_ERROR() << "ImageCache: failed to fetch image:" << reply->errorString() << ":" << url;
+        m_downloading.remove(url);
         return;
     };
     QLOG_DEBUG() << "ImageCatch: fetched" << url;
-    QImageReader image_reader(reply);
-    const QImage image = image_reader.read();
-    image.save(getImagePath(url));
-    emit imageReady(url);
+
+    // Save the downloaded bytes as they are, instead of decoding and
+    // re-encoding them, and do it without blocking the GUI thread. The url
+    // stays in m_downloading until the image is saved, so it isn't
+    // downloaded twice.
+    const QByteArray data = reply->readAll();
+    const QByteArray key = getKey(url);
+    const int priority = static_cast<int>(m_downloading.value(url, Priority::Display));
+    m_decode_pool.start([this, url, key, data]() {
+        m_pack->write(key, data);
+        const QImage image = QImage::fromData(data);
+        QMetaObject::invokeMethod(this, [this, url, image]() { onSaved(url, image); }, Qt::QueuedConnection);
+        }, priority);
 }
 
-QImage ImageCache::load(const QString& url) const {
-    const QString filename = getImagePath(url);
-    const QFile file(filename);
-    if (file.exists()) {
-        return QImage(getImagePath(url));
-    } else {
-        return QImage();
+void ImageCache::onSaved(const QString& url, const QImage& image) {
+    const Priority priority = m_downloading.take(url);
+    if (priority == Priority::WarmUp) {
+        // Nothing is waiting for this image, so leave room in memory for
+        // the images that are.
+        return;
     };
+    onDecoded(url, image);
 }
 
-QString ImageCache::getImagePath(const QString& url) const {
-    return m_directory + QDir::separator() + Util::Md5(url) + ".png";
+QImage ImageCache::load(const QString& url) {
+    const auto it = m_lru_index.find(url);
+    if (it != m_lru_index.end()) {
+        // Move the image to the front of the list.
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->second;
+    };
+    const QImage image = QImage::fromData(read(getKey(url)));
+    insert(url, image);
+    return image;
+}
+
+void ImageCache::insert(const QString& url, const QImage& image) {
+    if (image.isNull()) {
+        return;
+    };
+    const auto it = m_lru_index.find(url);
+    if (it != m_lru_index.end()) {
+        m_lru_bytes -= it->second->second.sizeInBytes();
+        m_lru.erase(it->second);
+        m_lru_index.erase(it);
+    };
+    m_lru.emplace_front(url, image);
+    m_lru_index[url] = m_lru.begin();
+    m_lru_bytes += image.sizeInBytes();
+
+    // Drop the least recently used images until the cache fits.
+    while ((m_lru_bytes > MAX_CACHED_IMAGE_BYTES) && (m_lru.size() > 1)) {
+        const Entry& oldest = m_lru.back();
+        m_lru_bytes -= oldest.second.sizeInBytes();
+        m_lru_index.erase(oldest.first);
+        m_lru.pop_back();
+    };
+}
+
+QByteArray ImageCache::getKey(const QString& url) const {
+    auto it = m_keys.find(url);
+    if (it == m_keys.end()) {
+        it = m_keys.insert(url, ImagePack::Key(url));
+    };
+    return it.value();
+}
+
+QString ImageCache::getImagePath(const QByteArray& key) const {
+    return m_directory + QDir::separator() + QString::fromLatin1(key.toHex()) + ".png";
+}
+
+QByteArray ImageCache::read(const QByteArray& key) const {
+    // This runs on the decode threads, too.
+    QByteArray data = m_pack->read(key);
+    if (data.isEmpty() && m_importing) {
+        QFile file(getImagePath(key));
+        if (file.open(QIODevice::ReadOnly)) {
+            data = file.readAll();
+        };
+    };
+    return data;
 }
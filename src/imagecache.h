@@ -19,28 +19,94 @@
 
 #pragma once
 
+#include <QHash>
 #include <QObject>
 #include <QImage>
+#include <QSet>
 #include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+#include <deque>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 
 class QNetworkAccessManager;
 class QNetworkReply;
+class ImagePack;
 
+// Downloads item images and keeps them on disk in an image pack, with the
+// most recently used images also kept decoded in memory. Images on disk are
+// decoded on a thread pool, so the GUI thread never waits on a file or a PNG
+// decoder.
+//
+// Only one download per url is in flight at a time, and the number of
+// downloads is capped. Images that are being displayed jump the queue.
 class ImageCache : public QObject {
     Q_OBJECT
 public:
     explicit ImageCache(
         QNetworkAccessManager& network_manager,
         const QString& directory);
+    ~ImageCache();
     bool contains(const QString& url) const;
-    QImage load(const QString& url) const;
+    QImage load(const QString& url);
 public slots:
     void fetch(const QString& url);
+    void prefetch(const QStringList& urls);
+
+    // Download every image that isn't already on disk in the background,
+    // behind any other requests.
+    void warmUp(const QStringList& urls);
     void onFetched();
 signals:
     void imageReady(const QString& url);
 private:
-    QString getImagePath(const QString& url) const;
+    enum class Priority : int {
+        WarmUp = 0,
+        Prefetch = 1,
+        Display = 2
+    };
+
+    void fetch(const QString& url, Priority priority);
+    void download(const QString& url, Priority priority);
+    std::deque<QString>& queue(Priority priority);
+    void startDownloads();
+    void decode(const QString& url, Priority priority);
+    void onDecoded(const QString& url, const QImage& image);
+    void onSaved(const QString& url, const QImage& image);
+    void insert(const QString& url, const QImage& image);
+    QByteArray getKey(const QString& url) const;
+    QString getImagePath(const QByteArray& key) const;
+    QByteArray read(const QByteArray& key) const;
+
     QNetworkAccessManager& m_network_manager;
     QString m_directory;
+
+    // Decoded images from most to least recently used.
+    typedef std::pair<QString, QImage> Entry;
+    std::list<Entry> m_lru;
+    std::unordered_map<QString, std::list<Entry>::iterator> m_lru_index;
+    qsizetype m_lru_bytes;
+
+    std::unique_ptr<ImagePack> m_pack;
+
+    // Older versions kept each image in its own file. Those are moved into
+    // the pack in the background, and read from the files until then.
+    std::atomic<bool> m_importing;
+
+    // Hashing the url is cheap, but it's done for every lookup.
+    mutable QHash<QString, QByteArray> m_keys;
+
+    QSet<QString> m_decoding;
+    QThreadPool m_decode_pool;
+
+    // Urls that are queued, downloading or being saved, with the highest
+    // priority they were requested at.
+    QHash<QString, Priority> m_downloading;
+    std::deque<QString> m_queues[3];
+    int m_active_downloads;
 };
@@ -0,0 +1,335 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "imagepack.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <limits>
+
+#include <QsLog/QsLog.h>
+
+constexpr quint32 PACK_MAGIC = 0x4b415051; // "QPAK"
+constexpr quint32 PACK_VERSION = 1;
+constexpr qint64 FILE_HEADER_SIZE = 8;
+constexpr qint64 KEY_SIZE = 16;
+constexpr qint64 RECORD_HEADER_SIZE = KEY_SIZE + 4;
+
+static QByteArray FileHeader() {
+    QByteArray header(FILE_HEADER_SIZE, '\0');
+    qToLittleEndian<quint32>(PACK_MAGIC, header.data());
+    qToLittleEndian<quint32>(PACK_VERSION, header.data() + 4);
+    return header;
+}
+
+static QByteArray RecordHeader(const QByteArray& key, qint64 size) {
+    QByteArray header = key;
+    header.resize(RECORD_HEADER_SIZE);
+    qToLittleEndian<quint32>(static_cast<quint32>(size), header.data() + KEY_SIZE);
+    return header;
+}
+
+ImagePack::ImagePack(const QString& filename)
+    : m_filename(filename)
+    , m_file(filename)
+    , m_map(nullptr)
+    , m_mapped(0)
+    , m_garbage(0)
+{
+    Open();
+}
+
+ImagePack::~ImagePack() {
+    Close();
+}
+
+QByteArray ImagePack::Key(const QString& url) {
+    // This is the same hash the image cache used to name its files.
+    return QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Md5);
+}
+
+bool ImagePack::Open() {
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        QLOG_ERROR() << "ImagePack: cannot open" << m_filename << ":" << m_file.errorString();
+        return false;
+    };
+    Scan();
+    QLOG_DEBUG() << "ImagePack: opened" << m_filename << "with" << m_index.size() << "images";
+    return true;
+}
+
+void ImagePack::Close() {
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+        m_mapped = 0;
+    };
+    m_file.close();
+    m_index.clear();
+    m_garbage = 0;
+}
+
+void ImagePack::Scan() {
+    const QByteArray header = m_file.read(FILE_HEADER_SIZE);
+    if ((header.size() < FILE_HEADER_SIZE)
+        || (qFromLittleEndian<quint32>(header.constData()) != PACK_MAGIC)
+        || (qFromLittleEndian<quint32>(header.constData() + 4) != PACK_VERSION))
+    {
+        if (m_file.size() > 0) {
+            QLOG_WARN() << "ImagePack: discarding unrecognized file" << m_filename;
+        };
+        m_file.resize(0);
+        m_file.seek(0);
+        m_file.write(FileHeader());
+        m_file.flush();
+        return;
+    };
+
+    Map();
+    const qint64 file_size = m_file.size();
+    qint64 offset = FILE_HEADER_SIZE;
+    while (offset + RECORD_HEADER_SIZE <= file_size) {
+        const QByteArray record = ReadEntry({ offset, RECORD_HEADER_SIZE });
+        const qint64 size = qFromLittleEndian<quint32>(record.constData() + KEY_SIZE);
+        if (offset + RECORD_HEADER_SIZE + size > file_size) {
+            break;
+        };
+        const QByteArray key = record.first(KEY_SIZE);
+        const auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_garbage += RECORD_HEADER_SIZE + it->size;
+        };
+        if (size == 0) {
+            m_garbage += RECORD_HEADER_SIZE;
+            m_index.remove(key);
+        } else {
+            m_index[key] = { offset + RECORD_HEADER_SIZE, size };
+        };
+        offset += RECORD_HEADER_SIZE + size;
+    };
+
+    // Drop a record that was only partly written.
+    if (offset < file_size) {
+        QLOG_WARN() << "ImagePack: truncating" << m_filename << "from" << file_size << "to" << offset << "bytes";
+        if (m_map) {
+            m_file.unmap(m_map);
+            m_map = nullptr;
+            m_mapped = 0;
+        };
+        m_file.resize(offset);
+    };
+}
+
+void ImagePack::Map() const {
+    if (m_map) {
+        m_file.unmap(m_map);
+    };
+    m_mapped = m_file.size();
+    m_map = m_file.map(0, m_mapped);
+    if (!m_map) {
+        m_mapped = 0;
+    };
+}
+
+QByteArray ImagePack::ReadEntry(const Entry& entry) const {
+    const qint64 end = entry.offset + entry.size;
+    if (end > m_mapped) {
+        // The record was appended after the file was mapped.
+        Map();
+    };
+    if (m_map && (end <= m_mapped)) {
+        return QByteArray(reinterpret_cast<const char*>(m_map + entry.offset), entry.size);
+    };
+    // Fall back to reading the file if it can't be mapped.
+    if (!m_file.seek(entry.offset)) {
+        return QByteArray();
+    };
+    return m_file.read(entry.size);
+}
+
+bool ImagePack::Append(const QByteArray& key, const QByteArray& data) {
+    const qint64 end = m_file.size();
+    const QByteArray header = RecordHeader(key, data.size());
+    const bool ok = m_file.seek(end)
+        && (m_file.write(header) == header.size())
+        && (m_file.write(data) == data.size())
+        && m_file.flush();
+    if (!ok) {
+        QLOG_ERROR() << "ImagePack: error writing to" << m_filename << ":" << m_file.errorString();
+        if (m_map) {
+            m_file.unmap(m_map);
+            m_map = nullptr;
+            m_mapped = 0;
+        };
+        m_file.resize(end);
+    };
+    return ok;
+}
+
+bool ImagePack::contains(const QByteArray& key) const {
+    QMutexLocker locker(&m_mutex);
+    return m_index.contains(key);
+}
+
+QByteArray ImagePack::read(const QByteArray& key) const {
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_index.constFind(key);
+    if (it == m_index.constEnd()) {
+        return QByteArray();
+    };
+    return ReadEntry(*it);
+}
+
+bool ImagePack::write(const QByteArray& key, const QByteArray& data) {
+    if ((key.size() != KEY_SIZE) || data.isEmpty() || (data.size() > std::numeric_limits<quint32>::max())) {
+        return false;
+    };
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen()) {
+        return false;
+    };
+    const qint64 offset = m_file.size();
+    if (!Append(key, data)) {
+        return false;
+    };
+    const auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        m_garbage += RECORD_HEADER_SIZE + it->size;
+    };
+    m_index[key] = { offset + RECORD_HEADER_SIZE, data.size() };
+    return true;
+}
+
+void ImagePack::remove(const QByteArray& key) {
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_index.find(key);
+    if ((it == m_index.end()) || !Append(key, QByteArray())) {
+        return;
+    };
+    m_garbage += RECORD_HEADER_SIZE + it->size + RECORD_HEADER_SIZE;
+    m_index.erase(it);
+}
+
+bool ImagePack::Compact() {
+    QHash<QByteArray, Entry> index;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_file.isOpen()) {
+            return false;
+        };
+        QLOG_INFO() << "ImagePack: compacting" << m_filename << "to remove" << m_garbage << "unused bytes";
+        index = m_index;
+    };
+    QSaveFile file(m_filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        QLOG_ERROR() << "ImagePack: cannot compact" << m_filename << ":" << file.errorString();
+        return false;
+    };
+    file.write(FileHeader());
+
+    // Copy one image at a time, so that other threads can use the pack
+    // while it's being compacted.
+    QHash<QByteArray, qint64> copied;
+    for (auto it = index.cbegin(); it != index.cend(); ++it) {
+        QByteArray data;
+        {
+            QMutexLocker locker(&m_mutex);
+            const auto current = m_index.constFind(it.key());
+            if ((current == m_index.constEnd()) || (current->offset != it->offset)) {
+                continue;
+            };
+            data = ReadEntry(*current);
+        };
+        file.write(RecordHeader(it.key(), data.size()));
+        file.write(data);
+        copied[it.key()] = it->offset;
+    };
+
+    // Catch up with the images that were removed or written meanwhile.
+    QMutexLocker locker(&m_mutex);
+    for (auto it = copied.cbegin(); it != copied.cend(); ++it) {
+        if (!m_index.contains(it.key())) {
+            file.write(RecordHeader(it.key(), 0));
+        };
+    };
+    for (auto it = m_index.cbegin(); it != m_index.cend(); ++it) {
+        if (copied.value(it.key(), -1) != it->offset) {
+            file.write(RecordHeader(it.key(), it->size));
+            file.write(ReadEntry(*it));
+        };
+    };
+
+    // Some platforms can't replace a file that is open or mapped.
+    Close();
+    const bool ok = file.commit();
+    if (!ok) {
+        QLOG_ERROR() << "ImagePack: error compacting" << m_filename << ":" << file.errorString();
+    };
+    Open();
+    return ok;
+}
+
+int ImagePack::Import(const QString& directory) {
+    const QDir dir(directory);
+    const QStringList filenames = dir.entryList({ "*.png" }, QDir::Files);
+    int count = 0;
+    for (const auto& filename : filenames) {
+        const QString hash = QFileInfo(filename).completeBaseName();
+        const QByteArray key = QByteArray::fromHex(hash.toLatin1());
+        if ((hash.size() != 2 * KEY_SIZE) || (key.size() != KEY_SIZE)) {
+            continue;
+        };
+        const QString path = dir.filePath(filename);
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            QLOG_WARN() << "ImagePack: cannot import" << path << ":" << file.errorString();
+            continue;
+        };
+        const QByteArray data = file.readAll();
+        file.close();
+        if (data.isEmpty()) {
+            // There is nothing to keep from a failed download.
+            QFile::remove(path);
+        } else if (contains(key) || write(key, data)) {
+            QFile::remove(path);
+            ++count;
+        };
+    };
+    return count;
+}
+
+int ImagePack::count() const {
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_index.size());
+}
+
+qint64 ImagePack::size() const {
+    QMutexLocker locker(&m_mutex);
+    return m_file.size();
+}
+
+qint64 ImagePack::garbage() const {
+    QMutexLocker locker(&m_mutex);
+    return m_garbage;
+}
@@ -0,0 +1,79 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+// Stores downloaded images in a single append-only file instead of one
+// small file per image. Each record is the 16-byte md5 hash of the image
+// url, the size of the data, and the image file exactly as it was
+// downloaded. A record with no data removes the image.
+//
+// The index is rebuilt by walking the record headers when the pack is
+// opened, and the file is memory-mapped for reads. All methods are
+// thread-safe.
+class ImagePack {
+public:
+    explicit ImagePack(const QString& filename);
+    ~ImagePack();
+
+    static QByteArray Key(const QString& url);
+
+    bool contains(const QByteArray& key) const;
+    QByteArray read(const QByteArray& key) const;
+    bool write(const QByteArray& key, const QByteArray& data);
+    void remove(const QByteArray& key);
+
+    // Rewrite the pack without removed or replaced records. The pack can
+    // still be used from other threads while this runs.
+    bool Compact();
+
+    // Move <md5>.png files from the old image cache directory into the pack.
+    int Import(const QString& directory);
+
+    int count() const;
+    qint64 size() const;
+    qint64 garbage() const;
+
+private:
+    struct Entry {
+        qint64 offset;
+        qint64 size;
+    };
+
+    bool Open();
+    void Close();
+    void Scan();
+    void Map() const;
+    QByteArray ReadEntry(const Entry& entry) const;
+    bool Append(const QByteArray& key, const QByteArray& data);
+
+    const QString m_filename;
+    mutable QMutex m_mutex;
+    mutable QFile m_file;
+    mutable uchar* m_map;
+    mutable qint64 m_mapped;
+    QHash<QByteArray, Entry> m_index;
+    qint64 m_garbage;
+};
@@ -383,7 +383,7 @@ void Item::CalculateCategories() {
     // name and seeing if that's something we can categorize.
     const auto indx = m_baseType.indexOf(" of ");
     if (indx >= 0) {
-        const auto altBaseType = m_baseType.first(indx);
+        const auto altBaseType = QStringView(m_baseType).first(indx);
         m_category = GetItemCategory(altBaseType);
         if (m_category.isEmpty() == false) {
             return;
@@ -448,7 +448,7 @@ void Item::GenerateMods(const rapidjson::Value& json) {
         if (HasArray(json, type)) {
             for (const auto& mod : json[type]) {
                 if (mod.IsString()) {
-                    AddModToTable(mod.GetString(), &m_mod_table);
+                    AddModToTable(mod.GetString(), mod.GetStringLength(), &m_mod_table);
                 };
             };
         };
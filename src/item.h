@@ -30,6 +30,7 @@
 #include <rapidjson/document.h>
 
 #include "itemlocation.h"
+#include "modlist.h"
 
 extern const std::vector<QString> ITEM_MOD_TYPES;
 
@@ -59,7 +60,6 @@ struct ItemSocket {
 };
 
 typedef std::vector<QString> ItemMods;
-typedef std::unordered_map<QString, double> ModTable;
 
 class Item {
 public:
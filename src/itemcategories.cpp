@@ -20,9 +20,11 @@
 #include "itemcategories.h"
 
 #include <QByteArray>
+#include <QDataStream>
 #include <QString>
 
 #include <map>
+#include <vector>
 
 #include <QsLog/QsLog.h>
 #include <rapidjson/document.h>
@@ -31,6 +33,85 @@
 #include "filters.h"
 #include "util/util.h"
 
+// An immutable open-addressing hash table that maps base types directly to
+// their lowercase category names. It's built once after the RePoE data is
+// loaded, and lookups take a QStringView so callers can search for part of
+// a string without copying it.
+class CategoryTable {
+public:
+    void Build(
+        const std::map<QString, QString>& base_types,
+        const std::map<QString, QString>& classes);
+    const QString* Find(QStringView base_type) const;
+    bool empty() const { return m_categories.empty(); };
+private:
+    struct Slot {
+        QString base_type;
+        size_t hash{ 0 };
+        int category{ -1 };
+    };
+    std::vector<Slot> m_slots;
+    std::vector<QString> m_categories;
+    size_t m_mask{ 0 };
+};
+
+void CategoryTable::Build(
+    const std::map<QString, QString>& base_types,
+    const std::map<QString, QString>& classes)
+{
+    m_slots.clear();
+    m_categories.clear();
+
+    // Resolve each item class to an index into the list of categories.
+    std::map<QString, int> class_categories;
+    std::map<QString, int> category_indices;
+    for (const auto& pair : classes) {
+        const QString category = pair.second.toLower();
+        const auto it = category_indices.emplace(category, static_cast<int>(m_categories.size()));
+        if (it.second) {
+            m_categories.push_back(category);
+        };
+        class_categories[pair.first] = it.first->second;
+    };
+
+    // Keep the load factor at or below one half so probe sequences stay short.
+    size_t capacity = 16;
+    while (capacity < 2 * base_types.size()) {
+        capacity *= 2;
+    };
+    m_slots.resize(capacity);
+    m_mask = capacity - 1;
+
+    for (const auto& pair : base_types) {
+        const auto it = class_categories.find(pair.second);
+        if (it == class_categories.end()) {
+            continue;
+        };
+        const size_t hash = qHash(QStringView(pair.first));
+        size_t i = hash & m_mask;
+        while (m_slots[i].category >= 0) {
+            i = (i + 1) & m_mask;
+        };
+        m_slots[i].base_type = pair.first;
+        m_slots[i].hash = hash;
+        m_slots[i].category = it->second;
+    };
+}
+
+const QString* CategoryTable::Find(QStringView base_type) const {
+    if (m_slots.empty()) {
+        return nullptr;
+    };
+    const size_t hash = qHash(base_type);
+    for (size_t i = hash & m_mask; m_slots[i].category >= 0; i = (i + 1) & m_mask) {
+        const Slot& slot = m_slots[i];
+        if ((slot.hash == hash) && (slot.base_type == base_type)) {
+            return &m_categories[slot.category];
+        };
+    };
+    return nullptr;
+}
+
 class CATEGORY_DATA {
 private:
     CATEGORY_DATA() = default;
@@ -43,9 +124,40 @@ public:
     std::map<QString, QString> m_itemClassKeyToValue;
     std::map<QString, QString> m_itemClassValueToKey;
     std::map<QString, QString> m_itemBaseTypeToClass;
+    CategoryTable m_baseTypeToCategory;
     QStringList categories;
 };
 
+static void UpdateCategories(CATEGORY_DATA& data) {
+    data.categories.clear();
+    for (const auto& pair : data.m_itemClassValueToKey) {
+        data.categories.append(pair.first);
+    };
+    data.categories.append(CategorySearchFilter::k_Default);
+    data.categories.sort();
+}
+
+template <typename Map>
+static void SaveMap(QDataStream& stream, const Map& map) {
+    stream << static_cast<quint32>(map.size());
+    for (const auto& pair : map) {
+        stream << pair.first << pair.second;
+    };
+}
+
+template <typename Map>
+static bool LoadMap(QDataStream& stream, Map& map) {
+    map.clear();
+    quint32 size = 0;
+    stream >> size;
+    for (quint32 i = 0; (i < size) && (stream.status() == QDataStream::Ok); ++i) {
+        QString key, value;
+        stream >> key >> value;
+        map[key] = value;
+    };
+    return (stream.status() == QDataStream::Ok);
+}
+
 void InitItemClasses(const QByteArray& classes) {
 
     static bool classes_initialized = false;
@@ -70,7 +182,6 @@ void InitItemClasses(const QByteArray& classes) {
     data.m_itemClassValueToKey.clear();
 
     QLOG_TRACE() << "InitItemClasses() processing data";
-    QSet<QString> cats;
     for (auto itr = doc.MemberBegin(); itr != doc.MemberEnd(); ++itr) {
         const QString key = itr->name.GetString();
         const QString value = itr->value.FindMember("name")->value.GetString();
@@ -83,11 +194,8 @@ void InitItemClasses(const QByteArray& classes) {
         };
         data.m_itemClassKeyToValue[key] = value;
         data.m_itemClassValueToKey[value] = key;
-        cats.insert(value);
     };
-    data.categories = cats.values();
-    data.categories.append(CategorySearchFilter::k_Default);
-    data.categories.sort();
+    UpdateCategories(data);
 
     classes_initialized = true;
 }
@@ -131,29 +239,54 @@ void InitItemBaseTypes(const QByteArray& baseTypes) {
     basetypes_initialized = true;
 }
 
-QString GetItemCategory(const QString& baseType) {
+void SaveItemCategories(QDataStream& stream) {
+    const auto& data = CATEGORY_DATA::instance();
+    SaveMap(stream, data.m_itemClassKeyToValue);
+    SaveMap(stream, data.m_itemClassValueToKey);
+    SaveMap(stream, data.m_itemBaseTypeToClass);
+}
 
+void InitItemCategories() {
+    QLOG_TRACE() << "InitItemCategories() entered";
     auto& data = CATEGORY_DATA::instance();
+    data.m_baseTypeToCategory.Build(data.m_itemBaseTypeToClass, data.m_itemClassKeyToValue);
+}
 
-    if (data.m_itemClassKeyToValue.empty()) {
-        QLOG_ERROR() << "Item classes have not been initialized";
-        return "";
+bool LoadItemCategories(QDataStream& stream) {
+    auto& data = CATEGORY_DATA::instance();
+    if (LoadMap(stream, data.m_itemClassKeyToValue)
+        && LoadMap(stream, data.m_itemClassValueToKey)
+        && LoadMap(stream, data.m_itemBaseTypeToClass))
+    {
+        UpdateCategories(data);
+        return true;
     };
+    QLOG_ERROR() << "Error loading cached item categories";
+    data.m_itemClassKeyToValue.clear();
+    data.m_itemClassValueToKey.clear();
+    data.m_itemBaseTypeToClass.clear();
+    data.categories.clear();
+    return false;
+}
+
+bool HasItemCategories() {
+    const auto& data = CATEGORY_DATA::instance();
+    return !data.m_itemClassKeyToValue.empty() && !data.m_itemBaseTypeToClass.empty();
+}
+
+QString GetItemCategory(QStringView baseType) {
+
+    auto& data = CATEGORY_DATA::instance();
 
-    if (data.m_itemBaseTypeToClass.empty()) {
-        QLOG_ERROR() << "Item base types have not been initialized";
+    if (data.m_baseTypeToCategory.empty()) {
+        QLOG_ERROR() << "Item categories have not been initialized";
         return "";
     };
 
-    auto rslt = data.m_itemBaseTypeToClass.find(baseType);
-    if (rslt != data.m_itemBaseTypeToClass.end()) {
-        QString key = rslt->second;
-        rslt = data.m_itemClassKeyToValue.find(key);
-        if (rslt != data.m_itemClassKeyToValue.end()) {
-            QString category = rslt->second.toLower();
-            QLOG_TRACE() << "GetItemCategory: category is" << category;
-            return category;
-        };
+    const QString* category = data.m_baseTypeToCategory.Find(baseType);
+    if (category) {
+        QLOG_TRACE() << "GetItemCategory: category is" << *category;
+        return *category;
     };
 
     QLOG_TRACE() << "GetItemCategory: could not categorize baseType:" << baseType;
@@ -20,13 +20,28 @@
 #pragma once
 
 #include <QStringList>
+#include <QStringView>
 
 class QByteArray;
+class QDataStream;
 class QString;
 
 void InitItemClasses(const QByteArray& classes);
 void InitItemBaseTypes(const QByteArray& baseTypes);
 
-QString GetItemCategory(const QString& baseType);
+// Build the lookup table used by GetItemCategory(). This should be called
+// once both the item classes and base types have been loaded.
+void InitItemCategories();
+
+// Write the compiled item classes and base types to a stream, so they can
+// be loaded again without parsing the RePoE data.
+void SaveItemCategories(QDataStream& stream);
+bool LoadItemCategories(QDataStream& stream);
+
+// Whether there are any item classes and base types, which there won't be
+// if the RePoE data couldn't be parsed.
+bool HasItemCategories();
+
+QString GetItemCategory(QStringView baseType);
 
 const QStringList& GetItemCategories();
@@ -0,0 +1,497 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "itemindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <set>
+
+#include <QtAlgorithms>
+
+#include <QsLog/QsLog.h>
+
+#include "filters.h"
+
+ItemBitmap::ItemBitmap(size_t size)
+    : m_size(size)
+    , m_words((size + 63) / 64, 0)
+{}
+
+void ItemBitmap::Set(size_t position) {
+    m_words[position / 64] |= (quint64(1) << (position % 64));
+}
+
+bool ItemBitmap::Test(size_t position) const {
+    return (m_words[position / 64] >> (position % 64)) & 1;
+}
+
+// These loops are simple enough for the compiler to vectorize.
+ItemBitmap& ItemBitmap::operator&=(const ItemBitmap& other) {
+    const size_t count = std::min(m_words.size(), other.m_words.size());
+    for (size_t i = 0; i < count; ++i) {
+        m_words[i] &= other.m_words[i];
+    };
+    std::fill(m_words.begin() + count, m_words.end(), 0);
+    return *this;
+}
+
+ItemBitmap& ItemBitmap::operator|=(const ItemBitmap& other) {
+    const size_t count = std::min(m_words.size(), other.m_words.size());
+    for (size_t i = 0; i < count; ++i) {
+        m_words[i] |= other.m_words[i];
+    };
+    return *this;
+}
+
+std::vector<size_t> ItemBitmap::Positions() const {
+    std::vector<size_t> positions;
+    for (size_t i = 0; i < m_words.size(); ++i) {
+        for (quint64 word = m_words[i]; word != 0; word &= (word - 1)) {
+            positions.push_back((i * 64) + qCountTrailingZeroBits(word));
+        };
+    };
+    return positions;
+}
+
+void ItemIndex::Clear() {
+    m_items.clear();
+    m_positions.clear();
+    m_added.clear();
+    m_previous_positions.clear();
+    m_changed_locations.clear();
+    m_tabs.clear();
+    m_item_tabs.clear();
+    m_changed_tabs.clear();
+    ++m_generation;
+    m_mods.clear();
+    m_names.clear();
+    m_name_offsets.clear();
+    m_trigrams.clear();
+    m_flags.clear();
+    m_frame_types.clear();
+    m_categories.clear();
+}
+
+bool ItemIndex::IsBuiltFrom(const Items& items) const {
+    return (items.size() == m_items.size())
+        && std::equal(items.begin(), items.end(), m_items.begin());
+}
+
+// Return the distinct trigrams of a string, packing each
+// into an integer key.
+static std::vector<quint64> GetTrigrams(QStringView text) {
+    std::vector<quint64> trigrams;
+    if (text.size() >= 3) {
+        trigrams.reserve(text.size() - 2);
+        for (qsizetype i = 0; i + 2 < text.size(); ++i) {
+            trigrams.push_back(
+                (quint64(text[i].unicode()) << 32) |
+                (quint64(text[i + 1].unicode()) << 16) |
+                (quint64(text[i + 2].unicode())));
+        };
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    };
+    return trigrams;
+}
+
+void ItemIndex::Update(const Items& items) {
+
+    std::unordered_map<const Item*, size_t> positions;
+    positions.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        positions.emplace(items[i].get(), i);
+    };
+
+    // Find the mods touched by items that are going away or are new,
+    // so that each posting list only has to be fixed up once.
+    std::set<ModId> touched;
+    std::vector<const Item*> removed;
+    for (const auto& item : m_items) {
+        if (positions.count(item.get()) == 0) {
+            removed.push_back(item.get());
+            for (const auto& mod : item->mod_table()) {
+                touched.insert(mod.first);
+            };
+        };
+    };
+    std::vector<const Item*> added;
+    for (const auto& item : items) {
+        if (m_positions.count(item.get()) == 0) {
+            added.push_back(item.get());
+            for (const auto& mod : item->mod_table()) {
+                touched.insert(mod.first);
+            };
+        };
+    };
+
+    // Drop postings for removed items from the lists they were in.
+    const std::set<const Item*> removed_set(removed.begin(), removed.end());
+    if (!removed_set.empty()) {
+        for (const auto& mod : touched) {
+            if (mod >= static_cast<ModId>(m_mods.size())) {
+                continue;
+            };
+            auto& list = m_mods[mod];
+            list.postings.erase(std::remove_if(list.postings.begin(), list.postings.end(),
+                [&](const Posting& posting) { return removed_set.count(posting.item) > 0; }),
+                list.postings.end());
+            list.unvalued.erase(std::remove_if(list.unvalued.begin(), list.unvalued.end(),
+                [&](const Item* item) { return removed_set.count(item) > 0; }),
+                list.unvalued.end());
+        };
+    };
+
+    // Append postings for new items, then restore the sort order.
+    for (const auto* item : added) {
+        AddItem(item);
+    };
+    for (const auto& mod : touched) {
+        if (mod < static_cast<ModId>(m_mods.size())) {
+            auto& list = m_mods[mod];
+            std::sort(list.postings.begin(), list.postings.end());
+        };
+    };
+
+    UpdateNames(items, removed_set);
+    UpdateAttributes(items);
+
+    // Remember what changed so that searches can update their results
+    // without checking items they have already seen.
+    m_added.clear();
+    m_previous_positions.assign(items.size(), npos);
+    m_changed_locations.clear();
+    for (size_t i = 0; i < items.size(); ++i) {
+        const auto it = m_positions.find(items[i].get());
+        if (it != m_positions.end()) {
+            m_previous_positions[i] = it->second;
+        } else {
+            m_added.push_back(i);
+            m_changed_locations.insert(items[i]->location());
+        };
+    };
+    for (const auto* item : removed) {
+        m_changed_locations.insert(item->location());
+    };
+    UpdateTabs(items);
+    ++m_generation;
+
+    m_items = items;
+    m_positions = std::move(positions);
+
+    QLOG_DEBUG() << "ItemIndex: indexed" << added.size() << "new items and removed" << removed.size()
+        << "items";
+}
+
+void ItemIndex::UpdateNames(const Items& items, const std::set<const Item*>& removed) {
+
+    // Drop the trigram postings of removed items.
+    std::set<quint64> touched;
+    for (const auto* item : removed) {
+        for (const auto trigram : GetTrigrams(name(m_positions.at(item)))) {
+            touched.insert(trigram);
+        };
+    };
+    for (const auto trigram : touched) {
+        auto it = m_trigrams.find(trigram);
+        if (it == m_trigrams.end()) {
+            continue;
+        };
+        auto& list = it->second;
+        list.erase(std::remove_if(list.begin(), list.end(),
+            [&](const Item* item) { return removed.count(item) > 0; }),
+            list.end());
+        if (list.empty()) {
+            m_trigrams.erase(it);
+        };
+    };
+
+    // Rebuild the name buffer, reusing the lowercase names of items
+    // that were already indexed so only new items are lowered.
+    QString names;
+    names.reserve(m_names.size());
+    std::vector<qsizetype> offsets;
+    offsets.reserve(items.size() + 1);
+    for (const auto& item : items) {
+        offsets.push_back(names.size());
+        const auto it = m_positions.find(item.get());
+        if (it != m_positions.end()) {
+            names.append(name(it->second));
+        } else {
+            const QString lowered = item->PrettyName().toLower();
+            for (const auto trigram : GetTrigrams(lowered)) {
+                m_trigrams[trigram].push_back(item.get());
+            };
+            names.append(lowered);
+        };
+        names.append(QChar('\n'));
+    };
+    offsets.push_back(names.size());
+
+    m_names.swap(names);
+    m_name_offsets.swap(offsets);
+}
+
+void ItemIndex::UpdateAttributes(const Items& items) {
+
+    const size_t count = items.size();
+    std::vector<ItemBitmap> flags(static_cast<size_t>(Flag::Count), ItemBitmap(count));
+    std::vector<ItemBitmap> frame_types;
+    std::unordered_map<QString, ItemBitmap> categories;
+
+    const auto set = [&](Flag flag, size_t position) {
+        flags[static_cast<size_t>(flag)].Set(position);
+    };
+    const ItemBitmap& altart = FindFlag(Flag::Altart);
+
+    for (size_t i = 0; i < count; ++i) {
+        const Item& item = *items[i];
+        if (item.corrupted()) {
+            set(Flag::Corrupted, i);
+        };
+        if (item.crafted()) {
+            set(Flag::Crafted, i);
+        };
+        if (item.enchanted()) {
+            set(Flag::Enchanted, i);
+        };
+        if (item.hasInfluence()) {
+            set(Flag::Influenced, i);
+        };
+        if (!item.identified()) {
+            set(Flag::Unidentified, i);
+        };
+
+        // Checking for alternate art is expensive, so reuse the
+        // result for items that were already indexed.
+        const auto it = m_positions.find(&item);
+        const bool is_altart = (it != m_positions.end())
+            ? altart.Test(it->second)
+            : AltartFilter::IsAltart(item);
+        if (is_altart) {
+            set(Flag::Altart, i);
+        };
+
+        const int frame_type = item.frameType();
+        if (frame_type >= 0) {
+            if (frame_type >= static_cast<int>(frame_types.size())) {
+                frame_types.resize(frame_type + 1, ItemBitmap(count));
+            };
+            frame_types[frame_type].Set(i);
+        };
+
+        auto category = categories.find(item.category());
+        if (category == categories.end()) {
+            category = categories.emplace(item.category(), ItemBitmap(count)).first;
+        };
+        category->second.Set(i);
+    };
+
+    m_flags.swap(flags);
+    m_frame_types.swap(frame_types);
+    m_categories.swap(categories);
+}
+
+const ItemBitmap& ItemIndex::FindFlag(Flag flag) const {
+    static const ItemBitmap empty;
+    const size_t index = static_cast<size_t>(flag);
+    return (index < m_flags.size()) ? m_flags[index] : empty;
+}
+
+ItemBitmap ItemIndex::FindFrameType(int frame_type) const {
+    if ((frame_type >= 0) && (frame_type < static_cast<int>(m_frame_types.size()))) {
+        return m_frame_types[frame_type];
+    };
+    return ItemBitmap(size());
+}
+
+ItemBitmap ItemIndex::FindCategory(const QString& query) const {
+    ItemBitmap result(size());
+    for (const auto& pair : m_categories) {
+        if (pair.first.contains(query)) {
+            result |= pair.second;
+        };
+    };
+    return result;
+}
+
+QStringView ItemIndex::name(size_t position) const {
+    const qsizetype offset = m_name_offsets[position];
+    const qsizetype length = m_name_offsets[position + 1] - offset - 1;
+    return QStringView(m_names).mid(offset, length);
+}
+
+void ItemIndex::AddItem(const Item* item) {
+    for (const auto& mod : item->mod_table()) {
+        if (mod.first >= static_cast<ModId>(m_mods.size())) {
+            m_mods.resize(mod.first + 1);
+        };
+        auto& list = m_mods[mod.first];
+        if (std::isnan(mod.second)) {
+            list.unvalued.push_back(item);
+        } else {
+            list.postings.push_back({ mod.second, item });
+        };
+    };
+}
+
+std::vector<size_t> ItemIndex::FindMod(const ModFilterData& mod) const {
+
+    std::vector<size_t> result;
+    if ((mod.id < 0) || (mod.id >= static_cast<ModId>(m_mods.size()))) {
+        return result;
+    };
+    const auto& list = m_mods[mod.id];
+
+    auto first = list.postings.begin();
+    auto last = list.postings.end();
+    if (mod.min_filled) {
+        first = std::lower_bound(first, last, mod.min,
+            [](const Posting& posting, double value) { return posting.value < value; });
+    };
+    if (mod.max_filled) {
+        last = std::upper_bound(first, last, mod.max,
+            [](double value, const Posting& posting) { return value < posting.value; });
+    };
+
+    result.reserve(std::distance(first, last) + list.unvalued.size());
+    for (auto posting = first; posting < last; ++posting) {
+        result.push_back(m_positions.at(posting->item));
+    };
+    for (const auto* item : list.unvalued) {
+        result.push_back(m_positions.at(item));
+    };
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<size_t> ItemIndex::FindName(const QString& query) const {
+
+    std::vector<size_t> result;
+    const QString lowered = query.toLower();
+    if (lowered.isEmpty()) {
+        result.resize(size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            result[i] = i;
+        };
+        return result;
+    };
+
+    const std::vector<quint64> trigrams = GetTrigrams(lowered);
+    if (trigrams.empty()) {
+        // The query is too short for the trigram index, so scan the
+        // name buffer and skip to the next item after each match.
+        qsizetype from = 0;
+        while ((from = m_names.indexOf(lowered, from)) >= 0) {
+            const auto next = std::upper_bound(m_name_offsets.begin(), m_name_offsets.end(), from);
+            const size_t position = std::distance(m_name_offsets.begin(), next) - 1;
+            result.push_back(position);
+            from = *next;
+        };
+        return result;
+    };
+
+    // Intersect the posting lists from the shortest to the longest.
+    std::vector<const std::vector<const Item*>*> lists;
+    lists.reserve(trigrams.size());
+    for (const auto trigram : trigrams) {
+        const auto it = m_trigrams.find(trigram);
+        if (it == m_trigrams.end()) {
+            return result;
+        };
+        lists.push_back(&it->second);
+    };
+    std::sort(lists.begin(), lists.end(),
+        [](const auto* a, const auto* b) { return a->size() < b->size(); });
+
+    std::vector<size_t> candidates;
+    for (const auto* list : lists) {
+        std::vector<size_t> positions;
+        positions.reserve(list->size());
+        for (const auto* item : *list) {
+            positions.push_back(m_positions.at(item));
+        };
+        std::sort(positions.begin(), positions.end());
+        if (list == lists.front()) {
+            candidates.swap(positions);
+        } else {
+            std::vector<size_t> intersection;
+            std::set_intersection(
+                candidates.begin(), candidates.end(),
+                positions.begin(), positions.end(),
+                std::back_inserter(intersection));
+            candidates.swap(intersection);
+        };
+        if (candidates.empty()) {
+            return result;
+        };
+    };
+
+    // Having every trigram doesn't mean they are in the right order,
+    // so verify each candidate.
+    result.reserve(candidates.size());
+    for (const auto position : candidates) {
+        if (name(position).contains(lowered)) {
+            result.push_back(position);
+        };
+    };
+    return result;
+}
+
+void ItemIndex::UpdateTabs(const Items& items) {
+    NumberTabs(items, m_tabs, m_item_tabs);
+    m_changed_tabs.assign(m_tabs.size(), false);
+    for (size_t i = 0; i < m_tabs.size(); ++i) {
+        m_changed_tabs[i] = (m_changed_locations.count(m_tabs[i]) > 0);
+    };
+}
+
+void ItemIndex::NumberTabs(const Items& items, std::vector<ItemLocation>& tabs, std::vector<quint32>& item_tabs) {
+
+    // Comparing locations is slow for characters, so only look up the
+    // location when it differs from the previous item's, since items in
+    // the same tab are usually next to each other.
+    using TabIds = std::map<ItemLocation, quint32>;
+    TabIds ids;
+    std::vector<TabIds::iterator> tab_ids;
+    tab_ids.reserve(items.size());
+    for (const auto& item : items) {
+        const ItemLocation& location = item->location();
+        if (tab_ids.empty() || !(tab_ids.back()->first == location)) {
+            tab_ids.push_back(ids.try_emplace(location, 0).first);
+        } else {
+            tab_ids.push_back(tab_ids.back());
+        };
+    };
+
+    tabs.clear();
+    tabs.reserve(ids.size());
+    for (auto& id : ids) {
+        id.second = static_cast<quint32>(tabs.size());
+        tabs.push_back(id.first);
+    };
+
+    item_tabs.resize(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        item_tabs[i] = tab_ids[i]->second;
+    };
+}
@@ -0,0 +1,186 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QString>
+#include <QStringView>
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "item.h"
+#include "modlist.h"
+
+struct ModFilterData;
+
+// A set of item positions stored one bit per item, so sets can be
+// combined a 64-bit word at a time.
+class ItemBitmap {
+public:
+    ItemBitmap() = default;
+    explicit ItemBitmap(size_t size);
+
+    void Set(size_t position);
+    bool Test(size_t position) const;
+    size_t size() const { return m_size; };
+
+    ItemBitmap& operator&=(const ItemBitmap& other);
+    ItemBitmap& operator|=(const ItemBitmap& other);
+
+    // Return the sorted positions of the bits that are set.
+    std::vector<size_t> Positions() const;
+
+private:
+    size_t m_size{ 0 };
+    std::vector<quint64> m_words;
+};
+
+// Indexes of the current items that let search filters find the items that
+// match without checking every item.
+//
+// Items are identified by their position in the list passed to Update(),
+// so the positions returned by lookups are in the same order as that list.
+class ItemIndex {
+public:
+    enum class Flag : int {
+        Corrupted,
+        Crafted,
+        Enchanted,
+        Influenced,
+        Unidentified,
+        Altart,
+        Count
+    };
+
+    // Update the index to match a new list of items. Only items that were
+    // added or removed since the last update are re-indexed, which makes a
+    // refresh of a few tabs cheap even when there are many items.
+    void Update(const Items& items);
+
+    void Clear();
+
+    size_t size() const { return m_items.size(); };
+
+    // Whether the index was last updated with exactly these items, so that
+    // its positions can be used to look them up.
+    bool IsBuiltFrom(const Items& items) const;
+
+    // The generation increases with every update, so searches can tell
+    // whether their cached results are one update behind.
+    quint64 generation() const { return m_generation; };
+
+    // The sorted positions of the items added by the last update.
+    const std::vector<size_t>& added() const { return m_added; };
+
+    // The position an item had before the last update, or npos if it's new.
+    size_t previous_position(size_t position) const { return m_previous_positions[position]; };
+
+    // The locations of items added or removed by the last update.
+    const std::set<ItemLocation>& changed_locations() const { return m_changed_locations; };
+
+    // The distinct locations of the items, sorted, so that a tab's position
+    // in this list can be used as its id.
+    const std::vector<ItemLocation>& tabs() const { return m_tabs; };
+
+    // The id of the tab that the item at a position is in.
+    size_t tab(size_t position) const { return m_item_tabs[position]; };
+
+    // Whether the last update added or removed items in a tab.
+    bool tab_changed(size_t tab) const { return m_changed_tabs[tab]; };
+
+    // Number the distinct locations of a list of items as above, for
+    // items that aren't in an index.
+    static void NumberTabs(const Items& items, std::vector<ItemLocation>& tabs, std::vector<quint32>& item_tabs);
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    // Return the sorted positions of items that have the mod with a value
+    // in the range given by the filter data.
+    std::vector<size_t> FindMod(const ModFilterData& mod) const;
+
+    // Return the sorted positions of items whose name contains the query,
+    // ignoring case.
+    std::vector<size_t> FindName(const QString& query) const;
+
+    // Return the items that have a flag set.
+    const ItemBitmap& FindFlag(Flag flag) const;
+
+    // Return the items with a frame type.
+    ItemBitmap FindFrameType(int frame_type) const;
+
+    // Return the items whose category contains the query.
+    ItemBitmap FindCategory(const QString& query) const;
+
+private:
+    struct Posting {
+        double value;
+        const Item* item;
+        bool operator<(const Posting& other) const {
+            return (value < other.value) || ((value == other.value) && (item < other.item));
+        };
+    };
+
+    struct PostingList {
+        // Sorted by value.
+        std::vector<Posting> postings;
+
+        // Mods without a numeric value can't be sorted, and they match
+        // any range, so they are kept apart.
+        std::vector<const Item*> unvalued;
+    };
+
+    void AddItem(const Item* item);
+    void UpdateNames(const Items& items, const std::set<const Item*>& removed);
+    QStringView name(size_t position) const;
+    void UpdateAttributes(const Items& items);
+    void UpdateTabs(const Items& items);
+
+    // Keep the indexed items alive so that their addresses can't be reused
+    // by new items while they are still in the index.
+    Items m_items;
+    std::unordered_map<const Item*, size_t> m_positions;
+
+    quint64 m_generation{ 0 };
+    std::vector<size_t> m_added;
+    std::vector<size_t> m_previous_positions;
+    std::set<ItemLocation> m_changed_locations;
+
+    std::vector<ItemLocation> m_tabs;
+    std::vector<quint32> m_item_tabs;
+    std::vector<bool> m_changed_tabs;
+
+    // Posting lists indexed by mod id.
+    std::vector<PostingList> m_mods;
+
+    // The lowercase names of all items in position order, each followed by a
+    // newline, so short queries can be found with a single scan. The offsets
+    // have one more element than there are items.
+    QString m_names;
+    std::vector<qsizetype> m_name_offsets;
+
+    // The items whose lowercase name contains each trigram.
+    std::unordered_map<quint64, std::vector<const Item*>> m_trigrams;
+
+    // Attribute bitmaps are rebuilt in a single pass on every update.
+    std::vector<ItemBitmap> m_flags;
+    std::vector<ItemBitmap> m_frame_types;
+    std::unordered_map<QString, ItemBitmap> m_categories;
+};
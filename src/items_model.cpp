@@ -136,20 +136,13 @@ QVariant ItemsModel::data(const QModelIndex& index, int role) const {
         };
         return QVariant();
     };
-    auto& column = m_search.columns()[index.column()];
     const int bucket_row = index.parent().row();
     if (m_search.has_bucket(bucket_row)) {
         const Bucket& bucket = m_search.bucket(bucket_row);
         const int item_row = index.row();
         if (bucket.has_item(item_row)) {
             const Item& item = *bucket.item(item_row);
-            if (role == Qt::DisplayRole) {
-                return column->value(item);
-            } else if (role == Qt::ForegroundRole) {
-                return column->color(item);
-            } else if (role == Qt::DecorationRole) {
-                return column->icon(item);
-            };
+            return m_search.CellData(item, index.column(), role);
         } else {
             QLOG_ERROR() << "items model cannot get data: bucket" << bucket_row << "does not have" << item_row << "items";
         };
@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "items_table_model.h"
+
+#include <QSignalBlocker>
+
+#include <algorithm>
+
+#include <QsLog/QsLog.h>
+
+#include "bucket.h"
+#include "items_model.h"
+#include "search.h"
+
+ItemsTableModel::ItemsTableModel(ItemsModel& tree_model, Search& search)
+    : m_tree_model(tree_model)
+    , m_search(search)
+{
+}
+
+int ItemsTableModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid()) {
+        return 0;
+    };
+    return static_cast<int>(m_search.item_bucket().items().size());
+}
+
+int ItemsTableModel::columnCount(const QModelIndex& parent) const {
+    if (parent.isValid()) {
+        return 0;
+    };
+    return static_cast<int>(m_search.columns().size());
+}
+
+QVariant ItemsTableModel::headerData(int section, Qt::Orientation /* orientation */, int role) const {
+    if (role == Qt::DisplayRole) {
+        return QString(m_search.columns()[section]->name());
+    };
+    return QVariant();
+}
+
+QVariant ItemsTableModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid()) {
+        return QVariant();
+    };
+    const Items& items = m_search.item_bucket().items();
+    const size_t row = static_cast<size_t>(index.row());
+    if (row >= items.size()) {
+        QLOG_ERROR() << "items table model cannot get data: row" << row << "does not exist";
+        return QVariant();
+    };
+    return m_search.CellData(*items[row], index.column(), role);
+}
+
+Qt::ItemFlags ItemsTableModel::flags(const QModelIndex& index) const {
+    if (!index.isValid()) {
+        return Qt::ItemFlags();
+    };
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemNeverHasChildren;
+}
+
+void ItemsTableModel::sort(int column, Qt::SortOrder order) {
+    emit layoutAboutToBeChanged();
+    {
+        // The tree model keeps track of the sort order for both views.
+        const QSignalBlocker blocker(m_tree_model);
+        m_tree_model.sort(column, order);
+    };
+    UpdateRows();
+    emit layoutChanged();
+}
+
+void ItemsTableModel::UpdateRows() {
+    const Items& items = m_search.item_bucket().items();
+    m_rows.clear();
+    m_rows.reserve(items.size());
+    for (size_t row = 0; row < items.size(); ++row) {
+        m_rows[items[row].get()] = static_cast<int>(row);
+    };
+}
+
+std::shared_ptr<Item> ItemsTableModel::item(int row) const {
+    const Items& items = m_search.item_bucket().items();
+    if ((row < 0) || (row >= static_cast<int>(items.size()))) {
+        return nullptr;
+    };
+    return items[row];
+}
+
+int ItemsTableModel::row(const Item& item) const {
+    const auto it = m_rows.find(&item);
+    return (it == m_rows.end()) ? -1 : it->second;
+}
+
+void ItemsTableModel::RowsChanged(std::vector<int> rows) {
+    if (rows.empty()) {
+        return;
+    };
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    const int last_column = columnCount() - 1;
+    size_t first = 0;
+    for (size_t i = 1; i <= rows.size(); ++i) {
+        if ((i == rows.size()) || (rows[i] != rows[i - 1] + 1)) {
+            emit dataChanged(index(rows[first], 0), index(rows[i - 1], last_column));
+            first = i;
+        };
+    };
+}
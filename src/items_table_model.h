@@ -0,0 +1,59 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QAbstractTableModel>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Item;
+class ItemsModel;
+class Search;
+
+// A flat table of every matching item, used for the "By Item" view. There
+// are no tab rows, so each row maps directly to an item, and the view can
+// lay out rows without walking a tree.
+class ItemsTableModel : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    explicit ItemsTableModel(ItemsModel& tree_model, Search& search);
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+    Qt::ItemFlags flags(const QModelIndex& index) const;
+    void sort(int column, Qt::SortOrder order);
+
+    // Rebuild the item-to-row lookup after the items or their order changed.
+    void UpdateRows();
+
+    std::shared_ptr<Item> item(int row) const;
+    int row(const Item& item) const;
+
+    // Emit one dataChanged signal for each run of adjacent rows.
+    void RowsChanged(std::vector<int> rows);
+
+private:
+    ItemsModel& m_tree_model;
+    Search& m_search;
+    std::unordered_map<const Item*, int> m_rows;
+};
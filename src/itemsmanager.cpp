@@ -162,7 +162,9 @@ void ItemsManager::PropagateTabBuyouts() {
 
 void ItemsManager::OnItemsRefreshed(const Items& items, const std::vector<ItemLocation>& tabs, bool initial_refresh) {
     QLOG_TRACE() << "ItemsManager::OnItemsRefreshed() entered";
+    emit ItemsAboutToRefresh();
     m_items = items;
+    m_index.Update(m_items);
 
     QLOG_DEBUG() << "There are" << m_items.size() << "items and" << tabs.size() << "tabs after the refresh.";
     int n = 0;
@@ -28,6 +28,7 @@
 #include "util/util.h"
 
 #include "item.h"
+#include "itemindex.h"
 #include "itemlocation.h"
 #include "itemsmanagerworker.h"
 #include "network_info.h"
@@ -64,6 +65,7 @@ public:
     void SetAutoUpdateInterval(int minutes);
     void SetAutoUpdate(bool update);
     const Items& items() const { return m_items; }
+    const ItemIndex& index() const { return m_index; }
     void ApplyAutoTabBuyouts();
     void ApplyAutoItemBuyouts();
     void PropagateTabBuyouts();
@@ -73,6 +75,8 @@ public slots:
     void OnItemsRefreshed(const Items& items, const std::vector<ItemLocation>& tabs, bool initial_refresh);
 signals:
     void UpdateSignal(TabSelection::Type type, const std::vector<ItemLocation>& tab_names = std::vector<ItemLocation>());
+    // Emitted before the items and the index are replaced.
+    void ItemsAboutToRefresh();
     void ItemsRefreshed(bool initial_refresh);
     void StatusUpdate(ProgramState state, const QString& status);
     void UpdateModListSignal();
@@ -89,4 +93,5 @@ private:
     std::unique_ptr<QTimer> m_auto_update_timer;
     std::unique_ptr<ItemsManagerWorker> m_worker;
     Items m_items;
+    ItemIndex m_index;
 };
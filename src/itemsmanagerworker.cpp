@@ -367,6 +367,9 @@ void ItemsManagerWorker::LegacyRefresh() {
         QNetworkRequest main_page_request = QNetworkRequest(QUrl(kMainPage));
         QLOG_TRACE() << "ItemsManagerWorker::LegacyRefresh() requesting main page to capture selected character:" << main_page_request.url().toString();
         main_page_request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
+        // The page depends on the session, so it must not come from the disk cache.
+        main_page_request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+        main_page_request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
         QNetworkReply* submit = m_network_manager.get(main_page_request);
         connect(submit, &QNetworkReply::finished, this, &ItemsManagerWorker::OnLegacyMainPageReceived);
     };
@@ -19,13 +19,13 @@
 
 #include "modlist.h"
 
-#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <set>
-#include <unordered_map>
-#include <utility>
 #include <vector>
 
-#include <QRegularExpression>
+#include <QDataStream>
 #include <QStringList>
 
 #include <QsLog/QsLog.h>
@@ -38,12 +38,10 @@ using rapidjson::HasBool;
 
 QStringListModel m_mod_list_model;
 std::set<QString> mods;
-std::unordered_map<QString, SumModGenerator*> mods_map;
-std::vector<SumModGen> mod_generators;
+ModMatcher mod_matcher;
 
-/* ------------------- TBD - FIX THIS!!! --------------------------
-
-// These are just summed, and the mod named as the first element of a vector is generated with value equaling the sum.
+// Each entry with more than one element defines a pseudo mod named after the first
+// element, whose value is the sum of every listed mod an item has.
 // Both implicit and explicit fields are considered.
 // This is pretty much the same list as poe.trade uses
 //
@@ -145,25 +143,66 @@ const std::vector<std::vector<QString>> simple_sum = {
     { "Can have multiple Crafted Mods" },
     { "* Leo's Level-28-capped-rolls mod", "Cannot roll Mods with Required Level above #" },
 };
-*/
+
+// Pseudo mods are listed after the real mods they are built from.
+const QString kPseudoPrefix = "(pseudo) (total) ";
+
+// For each real mod id, the pseudo mod ids that it adds to. This is built once
+// by InitModList() so that every pseudo mod of an item is computed in the same
+// pass that matches the item's mods.
+std::vector<std::vector<ModId>> pseudo_mods;
 
 QStringListModel& mod_list_model() {
     return m_mod_list_model;
 }
 
+ModId GetModId(const QString& name) {
+    return mod_matcher.Find(name);
+}
+
+void ModTable::Set(ModId id, double value) {
+    const auto it = std::lower_bound(m_mods.begin(), m_mods.end(), id,
+        [](const value_type& mod, ModId key) { return mod.first < key; });
+    if ((it != m_mods.end()) && (it->first == id)) {
+        it->second = value;
+    } else {
+        m_mods.emplace(it, id, value);
+    };
+}
+
+void ModTable::Add(ModId id, double value) {
+    const auto it = std::lower_bound(m_mods.begin(), m_mods.end(), id,
+        [](const value_type& mod, ModId key) { return mod.first < key; });
+    if ((it != m_mods.end()) && (it->first == id)) {
+        it->second += value;
+    } else {
+        m_mods.emplace(it, id, value);
+    };
+}
+
+const double* ModTable::Find(ModId id) const {
+    const auto it = std::lower_bound(m_mods.begin(), m_mods.end(), id,
+        [](const value_type& mod, ModId key) { return mod.first < key; });
+    if ((it != m_mods.end()) && (it->first == id)) {
+        return &it->second;
+    };
+    return nullptr;
+}
+
 void InitStatTranslations() {
     QLOG_TRACE() << "InitStatTranslations() entered";
     mods.clear();
 }
 
-void AddStatTranslations(const QByteArray& statTranslations) {
-    QLOG_TRACE() << "AddStatTranslations() entered";
+std::vector<QString> ParseStatTranslations(const QByteArray& statTranslations) {
+    QLOG_TRACE() << "ParseStatTranslations() entered";
 
+    std::vector<QString> translations;
     rapidjson::Document doc;
     doc.Parse(statTranslations.constData());
     if (doc.HasParseError()) {
         QLOG_ERROR() << "Couldn't properly parse Stat Translations from RePoE, canceling Mods Update";
-        return;
+        return translations;
     };
 
     for (auto& translation : doc) {
@@ -191,74 +230,219 @@ void AddStatTranslations(const QByteArray& statTranslations) {
                 };
             };
             if (stat_string.length() > 0) {
-                mods.insert(stat_string);
+                translations.push_back(stat_string);
             };
         };
     };
+    return translations;
+}
+
+void AddStatTranslations(const std::vector<QString>& translations) {
+    QLOG_TRACE() << "AddStatTranslations() entered";
+    mods.insert(translations.begin(), translations.end());
+}
+
+void AddStatTranslations(const QByteArray& statTranslations) {
+    AddStatTranslations(ParseStatTranslations(statTranslations));
+}
+
+bool HasStatTranslations() {
+    return !mods.empty();
+}
+
+void SaveStatTranslations(QDataStream& stream) {
+    stream << static_cast<quint32>(mods.size());
+    for (const auto& mod : mods) {
+        stream << mod;
+    };
+}
+
+bool LoadStatTranslations(QDataStream& stream) {
+    mods.clear();
+    quint32 size = 0;
+    stream >> size;
+    for (quint32 i = 0; (i < size) && (stream.status() == QDataStream::Ok); ++i) {
+        QString mod;
+        stream >> mod;
+        mods.insert(mods.end(), mod);
+    };
+    if (stream.status() != QDataStream::Ok) {
+        QLOG_ERROR() << "Error loading cached stat translations";
+        mods.clear();
+        return false;
+    };
+    return true;
 }
 
 void InitModList() {
     QLOG_TRACE() << "InitModList() entered";
 
-    std::set<QString> mod_strings;
-    mod_generators.clear();
-    mods_map.clear();
+    // The mods set is already sorted and free of duplicates, so the
+    // mod ids assigned by the matcher follow the same order.
+    mod_matcher.Clear();
+    QStringList mod_list;
+    mod_list.reserve(mods.size());
     for (auto& mod : mods) {
-        if (mod_strings.count(mod) > 0) {
-            QLOG_WARN() << "InitModList(): duplicate mod:" << mod;
+        mod_matcher.Add(mod);
+        mod_list.append(mod);
+    };
+
+    // Build the aggregation plan for pseudo mods.
+    pseudo_mods.clear();
+    pseudo_mods.resize(mod_matcher.size());
+    for (auto& sum : simple_sum) {
+        if (sum.size() < 2) {
+            continue;
+        };
+        const QString name = kPseudoPrefix + sum[0];
+        const ModId pseudo_id = mod_matcher.AddName(name);
+        bool used = false;
+        for (auto& mod : sum) {
+            const ModId id = mod_matcher.Find(mod);
+            if ((id >= 0) && (id < static_cast<ModId>(pseudo_mods.size()))) {
+                pseudo_mods[id].push_back(pseudo_id);
+                used = true;
+            };
+        };
+        if (used) {
+            mod_list.append(name);
         } else {
-            mod_strings.insert(mod);
-            std::vector<QString> list = { mod };
-            SumModGen gen = std::make_shared<SumModGenerator>(mod, list);
-            mods_map[mod] = gen.get();
-            mod_generators.push_back(gen);
+            QLOG_DEBUG() << "InitModList(): no stat translations for pseudo mod:" << name;
         };
     };
-    QStringList mod_list;
-    mod_list.reserve(mod_strings.size());
-    for (auto& mod : mod_strings) {
-        mod_list.append(mod);
-    };
+
     mod_list.sort(Qt::CaseInsensitive);
     m_mod_list_model.setStringList(mod_list);
 }
 
-void ModGenerator::Generate(const rapidjson::Value& json, ModTable* output) {
-    Generate(json.GetString(), output);
+ModMatcher::ModMatcher() {
+    Clear();
 }
 
-SumModGenerator::SumModGenerator(const QString& name, const std::vector<QString>& matches) :
-    m_name(name),
-    m_matches(matches)
-{}
-
-bool SumModGenerator::Match(const char* mod, double* output) {
-    bool found = false;
-    *output = 0.0;
-    for (auto& match : m_matches) {
-        double result = 0.0;
-        if (Util::MatchMod(match.toStdString().c_str(), mod, &result)) {
-            *output += result;
-            found = true;
+void ModMatcher::Clear() {
+    m_nodes.clear();
+    m_nodes.emplace_back();
+    m_names.clear();
+    m_indices.clear();
+}
+
+int ModMatcher::FindChild(int node, char byte) const {
+    for (int child = m_nodes[node].first_child; child >= 0; child = m_nodes[child].next_sibling) {
+        if (m_nodes[child].byte == byte) {
+            return child;
         };
     };
-    return found;
+    return -1;
+}
+
+int ModMatcher::AddChild(int node, char byte) {
+    const int child = static_cast<int>(m_nodes.size());
+    Node new_node;
+    new_node.byte = byte;
+    new_node.next_sibling = m_nodes[node].first_child;
+    m_nodes.push_back(new_node);
+    m_nodes[node].first_child = child;
+    return child;
+}
+
+void ModMatcher::Add(const QString& mod) {
+    const QByteArray utf8 = mod.toUtf8();
+    int node = 0;
+    for (const char byte : utf8) {
+        const int child = FindChild(node, byte);
+        node = (child >= 0) ? child : AddChild(node, byte);
+    };
+    if (m_nodes[node].mod >= 0) {
+        QLOG_WARN() << "ModMatcher: duplicate mod:" << mod;
+        return;
+    };
+    m_nodes[node].mod = static_cast<int>(m_names.size());
+    m_indices.emplace(mod, m_nodes[node].mod);
+    m_names.push_back(mod);
 }
 
-void SumModGenerator::Generate(const QString& mod, ModTable* output) {
-    double result;
-    if (Match(mod.toStdString().c_str(), &result)) {
-        (*output)[m_name] = result;
+int ModMatcher::AddName(const QString& name) {
+    const auto it = m_indices.find(name);
+    if (it != m_indices.end()) {
+        return it->second;
     };
+    const int index = static_cast<int>(m_names.size());
+    m_indices.emplace(name, index);
+    m_names.push_back(name);
+    return index;
 }
 
-void AddModToTable(const QString& raw_mod, ModTable* output) {
-    static const QRegularExpression rep("([0-9\\.]+)");
-    QString mod = raw_mod;
-    mod.replace(rep, "#");
-    auto rslt = mods_map.find(mod);
-    if (rslt != mods_map.end()) {
-        SumModGenerator* gen = rslt->second;
-        gen->Generate(raw_mod, output);
+int ModMatcher::Find(const QString& mod) const {
+    const auto it = m_indices.find(mod);
+    return (it == m_indices.end()) ? -1 : it->second;
+}
+
+static bool IsNumeric(char c) {
+    return ((c >= '0') && (c <= '9')) || (c == '.');
+}
+
+int ModMatcher::Match(const char* mod, size_t length, double* value) const {
+    const char* p = mod;
+    const char* const end = mod + length;
+    double sum = 0.0;
+    int count = 0;
+    int node = 0;
+    while (p < end) {
+        if (*p == '#') {
+            // A literal '#' in the mod text can never match a number.
+            return -1;
+        };
+        if (IsNumeric(*p)) {
+            // Parse the number the way strtod would, stopping at a second
+            // period, and skip over the rest of the run.
+            double number = 0.0;
+            double scale = 1.0;
+            bool fraction = false;
+            for (; (p < end) && IsNumeric(*p); ++p) {
+                if (*p == '.') {
+                    if (fraction) {
+                        while ((p < end) && IsNumeric(*p)) {
+                            ++p;
+                        };
+                        break;
+                    };
+                    fraction = true;
+                } else {
+                    number = (number * 10.0) + (*p - '0');
+                    if (fraction) {
+                        scale *= 10.0;
+                    };
+                };
+            };
+            sum += number / scale;
+            ++count;
+            node = FindChild(node, '#');
+        } else {
+            node = FindChild(node, *p);
+            ++p;
+        };
+        if (node < 0) {
+            return -1;
+        };
+    };
+    const int index = m_nodes[node].mod;
+    if (index >= 0) {
+        *value = (count > 0) ? (sum / count) : std::numeric_limits<double>::quiet_NaN();
+    };
+    return index;
+}
+
+void AddModToTable(const char* mod, size_t length, ModTable* output) {
+    double value = 0.0;
+    const int index = mod_matcher.Match(mod, length, &value);
+    if (index >= 0) {
+        output->Set(index, value);
+
+        // A mod without a number has nothing to add to a pseudo mod's total.
+        if (!std::isnan(value) && (index < static_cast<int>(pseudo_mods.size()))) {
+            for (const ModId pseudo_id : pseudo_mods[index]) {
+                output->Add(pseudo_id, value);
+            };
+        };
     };
 }
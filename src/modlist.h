@@ -24,43 +24,116 @@
 
 #include <memory>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <QStringList>
 #include <QStringListModel>
 
 #include <rapidjson/document.h>
 
+class QDataStream;
 class Item;
-typedef std::unordered_map<QString, double> ModTable;
 
+// Mods are identified by dense integer ids. The stat translations are numbered
+// in the order of the std::set they are collected in, which compares them
+// case-sensitively, and the pseudo mods are numbered after them. This is not
+// the order of mod_list_model(), which is sorted for display.
+typedef int ModId;
 
-// This generates regular expressions for mods and does other setup, should be called when the app starts, perhaps in main()
-// Maybe this is not needed and constexpr could do the trick, but VS doesn't support it right now.
+// The mods of an item as (id, value) pairs sorted by id. Items only have a
+// handful of mods, so a sorted vector is smaller and faster than a hash table.
+class ModTable {
+public:
+    typedef std::pair<ModId, double> value_type;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+
+    // Set the value of a mod, replacing any previous value.
+    void Set(ModId id, double value);
+
+    // Add to the value of a mod, which is used to total pseudo mods.
+    void Add(ModId id, double value);
+
+    // Return a pointer to the value of a mod, or nullptr if it's not present.
+    const double* Find(ModId id) const;
+
+    const_iterator begin() const { return m_mods.begin(); };
+    const_iterator end() const { return m_mods.end(); };
+    size_t size() const { return m_mods.size(); };
+    bool empty() const { return m_mods.empty(); };
+
+private:
+    std::vector<value_type> m_mods;
+};
+
+// This compiles the stat translations into the mod matcher, and should be called
+// once all of them have been added.
 void InitModList();
 
 QStringListModel& mod_list_model();
 
-class ModGenerator {
-public:
-    virtual ~ModGenerator() {};
-    void Generate(const rapidjson::Value& json, ModTable* output);
-    virtual void Generate(const QString& json, ModTable* output) = 0;
-};
+// Return the id of a mod template, or -1 if it's unknown.
+ModId GetModId(const QString& name);
 
-class SumModGenerator : public ModGenerator {
+// Matches the text of a mod against every stat translation template at once.
+//
+// Templates are stored in a trie over their UTF-8 bytes, where '#' stands for
+// a number. A maximal run of digits and periods in the mod text follows the
+// '#' edge, so a mod is matched and its values are extracted in a single pass
+// without building any intermediate strings.
+class ModMatcher {
 public:
-    SumModGenerator(const QString& name, const std::vector<QString>& sum);
-    virtual ~SumModGenerator() {};
-    virtual void Generate(const QString& json, ModTable* output);
-private:
-    bool Match(const char* mod, double* output);
+    ModMatcher();
 
-    QString m_name;
-    std::vector<QString> m_matches;
-};
+    void Clear();
+
+    // Add a template such as "+# to maximum Life".
+    void Add(const QString& mod);
+
+    // Return the index of the template that matches the mod text, or -1 if
+    // there isn't one. The average of the numbers in the mod is stored in value,
+    // or NaN if the template has no numbers.
+    int Match(const char* mod, size_t length, double* value) const;
 
-typedef std::shared_ptr<SumModGenerator> SumModGen;
+    // Add a name that has an index but is never matched against mod text,
+    // such as a pseudo mod, and return its index.
+    int AddName(const QString& name);
+
+    // Return the index of a template, or -1 if it hasn't been added.
+    int Find(const QString& mod) const;
+
+    const QString& name(int index) const { return m_names[index]; };
+    size_t size() const { return m_names.size(); };
+
+private:
+    // Nodes use a first-child/next-sibling layout to avoid one allocation per node.
+    struct Node {
+        char byte{ 0 };
+        int first_child{ -1 };
+        int next_sibling{ -1 };
+        int mod{ -1 };
+    };
+
+    int FindChild(int node, char byte) const;
+    int AddChild(int node, char byte);
+
+    std::vector<Node> m_nodes;
+    std::vector<QString> m_names;
+    std::unordered_map<QString, int> m_indices;
+};
 
 void InitStatTranslations();
 void AddStatTranslations(const QByteArray& statTranslations);
-void AddModToTable(const QString& mod, ModTable* output);
+void AddStatTranslations(const std::vector<QString>& translations);
+
+// Parsing doesn't touch any global state, so it's safe to parse several
+// stat translation files at once on different threads.
+std::vector<QString> ParseStatTranslations(const QByteArray& statTranslations);
+
+// Write the parsed stat translations to a stream, so they can be loaded
+// again without parsing the RePoE data.
+void SaveStatTranslations(QDataStream& stream);
+bool LoadStatTranslations(QDataStream& stream);
+
+// Whether any stat translations have been added or loaded.
+bool HasStatTranslations();
+void AddModToTable(const char* mod, size_t length, ModTable* output);
@@ -26,8 +26,12 @@
 #include <QObject>
 #include <QPushButton>
 
+#include <algorithm>
+#include <iterator>
+
 #include "ui/mainwindow.h"
 
+#include "itemindex.h"
 #include "modlist.h"
 
 SelectedMod::SelectedMod(const QString& name, double min, double max, bool min_filled, bool max_filled)
@@ -53,6 +57,7 @@ SelectedMod::SelectedMod(const QString& name, double min, double max, bool min_f
 
 void SelectedMod::OnModChanged() {
     m_data.mod = m_mod_select.currentText();
+    m_data.id = GetModId(m_data.mod);
     emit ModChanged(*this);
 }
 
@@ -113,6 +118,10 @@ void ModsFilter::FromForm(FilterData* data) {
     data->mod_data.clear();
     for (auto& mod : m_mods) {
         data->mod_data.push_back(mod->data());
+
+        // Resolve the name again in case the mod list was reloaded.
+        auto& mod_data = data->mod_data.back();
+        mod_data.id = GetModId(mod_data.mod);
     };
     m_active = !m_mods.empty();
 }
@@ -138,21 +147,47 @@ bool ModsFilter::Matches(const std::shared_ptr<Item>& item, FilterData* data) {
         if (mod.mod.isEmpty()) {
             continue;
         };
-        const ModTable& mod_table = item->mod_table();
-        if (!mod_table.count(mod.mod)) {
+        const double* value = item->mod_table().Find(mod.id);
+        if (!value) {
             return false;
         };
-        double value = mod_table.at(mod.mod);
-        if (mod.min_filled && value < mod.min) {
+        if (mod.min_filled && *value < mod.min) {
             return false;
         };
-        if (mod.max_filled && value > mod.max) {
+        if (mod.max_filled && *value > mod.max) {
             return false;
         };
     }
     return true;
 }
 
+bool ModsFilter::FindCandidates(FilterData* data, const ItemIndex& index, std::vector<size_t>* candidates) {
+    bool found = false;
+    for (auto& mod : data->mod_data) {
+        if (mod.mod.isEmpty()) {
+            continue;
+        };
+        std::vector<size_t> positions = index.FindMod(mod);
+        if (found) {
+            // Keep only the items that also matched the previous mods.
+            std::vector<size_t> intersection;
+            intersection.reserve(std::min(candidates->size(), positions.size()));
+            std::set_intersection(
+                candidates->begin(), candidates->end(),
+                positions.begin(), positions.end(),
+                std::back_inserter(intersection));
+            candidates->swap(intersection);
+        } else {
+            candidates->swap(positions);
+            found = true;
+        };
+        if (candidates->empty()) {
+            break;
+        };
+    };
+    return found;
+}
+
 void ModsFilter::AddNewMod() {
 
     // Create the mod, connect signals, and add it to the UI.
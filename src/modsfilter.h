@@ -86,6 +86,7 @@ public:
     void ToForm(FilterData* data);
     void ResetForm();
     bool Matches(const std::shared_ptr<Item>& item, FilterData* data);
+    bool FindCandidates(FilterData* data, const ItemIndex& index, std::vector<size_t>* candidates);
 private:
     void AddNewMod();
     void UpdateMod();
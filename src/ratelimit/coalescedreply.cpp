@@ -0,0 +1,69 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "coalescedreply.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+// Reply attributes that are copied from the original reply.
+constexpr std::array<QNetworkRequest::Attribute, 5> COPIED_ATTRIBUTES = {
+    QNetworkRequest::HttpStatusCodeAttribute,
+    QNetworkRequest::HttpReasonPhraseAttribute,
+    QNetworkRequest::RedirectionTargetAttribute,
+    QNetworkRequest::SourceIsFromCacheAttribute,
+    QNetworkRequest::Http2WasUsedAttribute
+};
+
+CoalescedReply::CoalescedReply(const QNetworkReply& source, const QByteArray& body)
+    : QNetworkReply()
+    , m_body(body)
+    , m_offset(0)
+{
+    setRequest(source.request());
+    setUrl(source.url());
+    setOperation(source.operation());
+    for (const auto& header : source.rawHeaderPairs()) {
+        setRawHeader(header.first, header.second);
+    };
+    for (const auto attribute : COPIED_ATTRIBUTES) {
+        const QVariant value = source.attribute(attribute);
+        if (value.isValid()) {
+            setAttribute(attribute, value);
+        };
+    };
+    setError(source.error(), source.errorString());
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    setFinished(true);
+}
+
+qint64 CoalescedReply::bytesAvailable() const {
+    return (m_body.size() - m_offset) + QIODevice::bytesAvailable();
+}
+
+qint64 CoalescedReply::readData(char* data, qint64 max_size) {
+    if (m_offset >= m_body.size()) {
+        return -1;
+    };
+    const qint64 count = std::min(max_size, m_body.size() - m_offset);
+    std::memcpy(data, m_body.constData() + m_offset, count);
+    m_offset += count;
+    return count;
+}
@@ -0,0 +1,43 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QNetworkReply>
+
+// A finished copy of a network reply that can be read independently of the
+// original. When identical requests are coalesced, each waiter gets one of
+// these, because the body of a QNetworkReply can only be read once.
+class CoalescedReply : public QNetworkReply {
+    Q_OBJECT
+public:
+    CoalescedReply(const QNetworkReply& source, const QByteArray& body);
+
+    void abort() override {};
+    qint64 bytesAvailable() const override;
+    bool isSequential() const override { return true; };
+
+protected:
+    qint64 readData(char* data, qint64 max_size) override;
+
+private:
+    const QByteArray m_body;
+    qint64 m_offset;
+};
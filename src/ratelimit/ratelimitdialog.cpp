@@ -127,12 +127,12 @@ void RateLimitDialog::OnPolicyUpdate(const RateLimitPolicy& policy)
     };
 }
 
-void RateLimitDialog::OnQueueUpdate(const QString& policy_name, int queued_requests) {
+void RateLimitDialog::OnQueueUpdate(const QString& policy_name, int queued_requests, int estimated_seconds) {
     for (int i = 0; i < m_treeWidget->topLevelItemCount(); ++i) {
         QTreeWidgetItem* item = m_treeWidget->topLevelItem(i);
         if (item->text(0) == policy_name) {
             if (queued_requests > 0) {
-                item->setText(1, QString::number(queued_requests));
+                item->setText(1, QString("%1 (~%2s)").arg(queued_requests).arg(estimated_seconds));
             } else {
                 item->setText(1, "");
             };
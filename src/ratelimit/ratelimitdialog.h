@@ -38,7 +38,7 @@ public:
 public slots:
     void OnPause(int pause, const QString& policy_name);
     void OnPolicyUpdate(const RateLimitPolicy& policy);
-    void OnQueueUpdate(const QString& policy_name, int queue_size);
+    void OnQueueUpdate(const QString& policy_name, int queue_size, int estimated_seconds);
 private:
     QVBoxLayout* m_layout;
     QTreeWidget* m_treeWidget;
@@ -22,6 +22,9 @@
 #include <QNetworkRequest>
 #include <QString>
 
+#include <memory>
+#include <vector>
+
 class QNetworkRequest;
 
 class RateLimitedReply;
@@ -49,6 +52,10 @@ struct RateLimitedRequest {
 
     std::unique_ptr<RateLimitedReply> reply;
 
+    // Replies for identical requests that were submitted while this one was
+    // waiting or in flight. They are completed with the same result.
+    std::vector<std::unique_ptr<RateLimitedReply>> duplicates;
+
 private:
 
     // Total number of requests that have every been constructed.
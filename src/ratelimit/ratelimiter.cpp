@@ -23,22 +23,29 @@
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 
+#include <algorithm>
 #include <array>
 #include <memory>
 
 #include <boost/bind/bind.hpp>
 #include <QsLog/QsLog.h>
 
+#include "datastore/datastore.h"
 #include "network_info.h"
 #include "util/fatalerror.h"
 #include "util/oauthmanager.h"
+#include "util/util.h"
 
 #include "ratelimitedreply.h"
 #include "ratelimitmanager.h"
 #include "ratelimitpolicy.h"
+#include "ratelimitsnapshot.h"
 
 constexpr int UPDATE_INTERVAL_MSEC = 1000;
 
+// How long to wait after a policy update before saving the rate limit state.
+constexpr int SAVE_DELAY_MSEC = 5000;
+
 // Create a list of all the attributes a QNetworkRequest or QNetwork reply can have,
 // since there is no other way to iterate over this list:
 // https://doc.qt.io/qt-6/qnetworkrequest.html#Attribute-enum (as of July 29, 2004)
@@ -75,18 +82,82 @@ constexpr std::array ATTRIBUTES = {
 RateLimiter::RateLimiter(
     QNetworkAccessManager& network_manager,
     OAuthManager& oauth_manager,
+    DataStore& datastore,
     POE_API mode)
     : m_network_manager(network_manager)
     , m_oauth_manager(oauth_manager)
+    , m_datastore(datastore)
     , m_mode(mode)
 {
     QLOG_TRACE() << "RateLimiter::RateLimiter() entered";
     m_update_timer.setSingleShot(false);
     m_update_timer.setInterval(UPDATE_INTERVAL_MSEC);
     connect(&m_update_timer, &QTimer::timeout, this, &RateLimiter::SendStatusUpdate);
+
+    m_save_timer.setSingleShot(true);
+    m_save_timer.setInterval(SAVE_DELAY_MSEC);
+    connect(&m_save_timer, &QTimer::timeout, this, &RateLimiter::SaveState);
+
+    LoadState();
+}
+
+RateLimiter::~RateLimiter() {
+    SaveState();
+}
+
+// Each API mode uses different endpoints, so they are saved separately.
+static QString StateKey(POE_API mode) {
+    return (mode == POE_API::OAUTH) ? "rate_limit_state_oauth" : "rate_limit_state_legacy";
+}
+
+void RateLimiter::LoadState() {
+
+    QLOG_TRACE() << "RateLimiter::LoadState() entered";
+    const QString json = m_datastore.Get(StateKey(m_mode));
+    if (json.isEmpty()) {
+        QLOG_DEBUG() << "RateLimiter: there is no saved rate limit state";
+        return;
+    };
+
+    const auto snapshots = Util::parseJson<std::vector<RateLimitSnapshot>>(json);
+    for (const auto& snapshot : snapshots) {
+        if (snapshot.policy.isEmpty() || snapshot.endpoints.empty() || snapshot.rules.empty()) {
+            QLOG_WARN() << "RateLimiter: ignoring an invalid saved rate limit policy";
+            continue;
+        };
+        QLOG_DEBUG() << "RateLimiter: restoring saved rate limit policy" << snapshot.policy;
+        RateLimitManager* manager = nullptr;
+        for (const auto& endpoint : snapshot.endpoints) {
+            manager = &GetManager(endpoint, snapshot.policy);
+        };
+        manager->Restore(snapshot);
+    };
+
+    // Restoring emits policy updates, but there is no need to save them again.
+    m_save_timer.stop();
 }
 
-RateLimiter::~RateLimiter() {}
+void RateLimiter::SaveState() {
+
+    QLOG_TRACE() << "RateLimiter::SaveState() entered";
+    m_save_timer.stop();
+
+    std::vector<RateLimitSnapshot> snapshots;
+    snapshots.reserve(m_managers.size());
+    for (const auto& manager : m_managers) {
+        RateLimitSnapshot snapshot;
+        for (const auto& pair : m_manager_by_endpoint) {
+            if (pair.second == manager.get()) {
+                snapshot.endpoints.push_back(pair.first);
+            };
+        };
+        manager->Save(snapshot);
+        if (!snapshot.policy.isEmpty()) {
+            snapshots.push_back(std::move(snapshot));
+        };
+    };
+    m_datastore.Set(StateKey(m_mode), QString::fromStdString(JS::serializeStruct(snapshots)));
+}
 
 RateLimitedReply* RateLimiter::Submit(
     const QString& endpoint,
@@ -99,6 +170,11 @@ RateLimitedReply* RateLimiter::Submit(
     // Make sure the user agent is set according to GGG's guidance.
     network_request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
 
+    // Rate limit headers describe the current state of the policy, so
+    // API replies must always come from the network and never be cached.
+    network_request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    network_request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+
     // Create a new rate limited reply that we can return to the calling function.
     auto* reply = new RateLimitedReply();
 
@@ -339,12 +415,16 @@ void RateLimiter::OnUpdateRequested()
 void RateLimiter::OnPolicyUpdated(const RateLimitPolicy& policy)
 {
     QLOG_TRACE() << "RateLimiter::OnPolicyUpdated() entered";
+    if (!m_save_timer.isActive()) {
+        m_save_timer.start();
+    };
     emit PolicyUpdate(policy);
 }
 
-void RateLimiter::OnQueueUpdated(const QString& policy_name, int queued_requests) {
+void RateLimiter::OnQueueUpdated(const QString& policy_name, int queued_requests, const QDateTime& estimated_finish) {
     QLOG_TRACE() << "RateLimiter::OnQueueUpdated() entered";
-    emit QueueUpdate(policy_name, queued_requests);
+    const qint64 seconds = QDateTime::currentDateTime().secsTo(estimated_finish);
+    emit QueueUpdate(policy_name, queued_requests, static_cast<int>(std::max(seconds, qint64(0))));
 }
 
 void RateLimiter::OnManagerPaused(const QString& policy_name, const QDateTime& until) {
@@ -33,6 +33,7 @@
 class QNetworkAccessManager;
 class QNetworkReply;
 
+class DataStore;
 class OAuthManager;
 class RateLimitedReply;
 class RateLimitManager;
@@ -46,6 +47,7 @@ public:
     RateLimiter(
         QNetworkAccessManager& network_manager,
         OAuthManager& oauth_manager,
+        DataStore& datastore,
         POE_API mode);
 
     ~RateLimiter();
@@ -65,8 +67,9 @@ signals:
     // Emitted when one of the policy managers has signalled a policy update.
     void PolicyUpdate(const RateLimitPolicy& policy);
 
-    // Emitted when a request has been added to a queue.
-    void QueueUpdate(const QString& policy_name, int queued_requests);
+    // Emitted when a request has been added to a queue, along with the number
+    // of seconds until the last queued request is expected to be sent.
+    void QueueUpdate(const QString& policy_name, int queued_requests, int estimated_seconds);
 
     // Signal sent to the UI so the user can see what's going on.
     void Paused(int seconds, const QString& policy_name);
@@ -75,17 +78,23 @@ private slots:
 
     void SendStatusUpdate();
 
+    // Save every policy and its recent history to the data store.
+    void SaveState();
+
     // Received from individual policy managers.
     void OnPolicyUpdated(const RateLimitPolicy& policy);
 
     // Received from individual policy managers.
-    void OnQueueUpdated(const QString& policy_name, int queued_requests);
+    void OnQueueUpdated(const QString& policy_name, int queued_requests, const QDateTime& estimated_finish);
 
     // Received from individual policy managers.
     void OnManagerPaused(const QString& policy_name, const QDateTime& until);
 
 private:
 
+    // Restore policies and history saved by a previous session.
+    void LoadState();
+
     // Process the first request for an endpoint we haven't encountered before.
     void SetupEndpoint(
         const QString& endpoint,
@@ -118,10 +127,17 @@ private:
     // Reference to the Application's OAuth manager.
     OAuthManager& m_oauth_manager;
 
+    // Where policies and history are saved between sessions. This is the
+    // account's data store, because rate limits are tracked per account.
+    DataStore& m_datastore;
+
     POE_API m_mode;
 
     QTimer m_update_timer;
 
+    // Used to avoid writing to the data store after every single reply.
+    QTimer m_save_timer;
+
     std::map<QDateTime, QString> m_pauses;
 
     std::list<std::unique_ptr<RateLimitManager>> m_managers;
@@ -30,10 +30,12 @@
 #include "util/fatalerror.h"
 #include "util/oauthmanager.h"
 
+#include "coalescedreply.h"
 #include "ratelimit.h"
 #include "ratelimitpolicy.h"
 #include "ratelimitedreply.h"
 #include "ratelimitedrequest.h"
+#include "ratelimitsnapshot.h"
 #include "ratelimiter.h"
 
 // This HTTP status code means there was a rate limit violation.
@@ -164,13 +166,24 @@ void RateLimitManager::ReceiveReply()
 
         // Since the request finished successfully, signal complete()
         // so anyone listening can handle the reply.
-        if (m_active_request->reply) {
+        if (!m_active_request->reply) {
+            QLOG_ERROR() << "Cannot complete the rate limited request because the reply is null.";
+        } else if (m_active_request->duplicates.empty()) {
             QLOG_TRACE() << "RateLimiteManager::ReceiveReply() about to emit 'complete' signal";
             emit m_active_request->reply->complete(reply);
         } else {
-            QLOG_ERROR() << "Cannot complete the rate limited request because the reply is null.";
+            // The body can only be read once, so every waiter gets its own copy.
+            QLOG_DEBUG() << m_policy->name() << "completing request" << m_active_request->id
+                << "for" << (m_active_request->duplicates.size() + 1) << "waiters";
+            const QByteArray body = reply->readAll();
+            emit m_active_request->reply->complete(new CoalescedReply(*reply, body));
+            for (const auto& duplicate : m_active_request->duplicates) {
+                emit duplicate->complete(new CoalescedReply(*reply, body));
+            };
+            reply->deleteLater();
         };
 
+        m_requests_by_url.remove(m_active_request->network_request.url(), m_active_request.get());
         m_active_request = nullptr;
 
         // Activate the next queued reqeust.
@@ -208,9 +221,16 @@ void RateLimitManager::ReceiveReply()
                 << "reply status was " << reply_status
                 << "and error was" << reply->error();
 
+            // The request is dropped without completing its reply, and so are
+            // the replies of any identical requests that were coalesced into it.
+            if (!m_active_request->duplicates.empty()) {
+                QLOG_ERROR() << "policy manager for" << m_policy->name()
+                    << "is also dropping" << m_active_request->duplicates.size()
+                    << "coalesced requests";
+            };
+            m_active_request->reply = nullptr;
+            m_active_request->duplicates.clear();
         };
-
-        m_active_request->reply = nullptr;
     };
 }
 
@@ -229,7 +249,8 @@ void RateLimitManager::Update(QNetworkReply* reply) {
         m_policy->Check(*new_policy);
     };
 
-    // Update the rate limit policy.
+    // Update the rate limit policy. The planner refers to the old one.
+    m_planner = nullptr;
     m_policy = std::move(new_policy);
 
     // Grow the history capacity if needed.
@@ -246,6 +267,46 @@ void RateLimitManager::Update(QNetworkReply* reply) {
     emit PolicyUpdated(policy());
 }
 
+void RateLimitManager::Restore(const RateLimitSnapshot& snapshot) {
+
+    QLOG_TRACE() << "RateLimitManager::Restore() entered";
+
+    m_planner = nullptr;
+    m_policy = std::make_unique<RateLimitPolicy>(snapshot);
+
+    // Make sure the history can hold everything the policy needs.
+    const size_t max_hits = m_policy->maximum_hits();
+    if (m_history.capacity() < max_hits) {
+        m_history.set_capacity(max_hits);
+    };
+
+    // The snapshot has the most recent reply first, just like the history.
+    m_history.clear();
+    for (const auto msecs : snapshot.history) {
+        if (m_history.full()) {
+            break;
+        };
+        m_history.push_back(QDateTime::fromMSecsSinceEpoch(msecs).toLocalTime());
+    };
+
+    QLOG_DEBUG() << m_policy->name()
+        << "restored with" << m_history.size() << "saved replies";
+
+    emit PolicyUpdated(policy());
+}
+
+void RateLimitManager::Save(RateLimitSnapshot& snapshot) const {
+    if (!m_policy) {
+        return;
+    };
+    m_policy->Save(snapshot);
+    snapshot.history.clear();
+    snapshot.history.reserve(m_history.size());
+    for (const auto& reply_time : m_history) {
+        snapshot.history.push_back(reply_time.toMSecsSinceEpoch());
+    };
+}
+
 // If the rate limit manager is busy, the request will be queued.
 // Otherwise, the request will be sent immediately, making the
 // manager busy and causing subsequent requests to be queued.
@@ -255,15 +316,49 @@ void RateLimitManager::QueueRequest(
     RateLimitedReply* reply)
 {
     QLOG_TRACE() << "RateLimitManager::QueueRequest() entered";
+
+    // An identical request that is already waiting or in flight will be
+    // completed for this caller, too, without using another slot.
+    RateLimitedRequest* existing = FindRequest(network_request);
+    if (existing) {
+        QLOG_DEBUG() << m_policy->name() << "coalescing a request for" << endpoint
+            << "with request" << existing->id;
+        existing->duplicates.emplace_back(reply);
+        return;
+    };
+
     auto request = std::make_unique<RateLimitedRequest>(endpoint, network_request, reply);
+    m_requests_by_url.insert(network_request.url(), request.get());
     m_queued_requests.push_back(std::move(request));
     if (m_active_request) {
-        emit QueueUpdated(m_policy->name(), static_cast<int>(m_queued_requests.size()));
+        // Only the new request has to be planned, as the last one in the queue.
+        // The whole queue is planned again when the next request is activated,
+        // which can spread the earlier requests out further than this plan.
+        const QDateTime estimated_finish = m_planner
+            ? m_planner->PlanNext(1)
+            : PlanSends().back();
+        emit QueueUpdated(m_policy->name(), static_cast<int>(m_queued_requests.size()), estimated_finish);
     } else {
         ActivateRequest();
     };
 }
 
+RateLimitedRequest* RateLimitManager::FindRequest(const QNetworkRequest& network_request) const {
+    const auto range = m_requests_by_url.equal_range(network_request.url());
+    for (auto it = range.first; it != range.second; ++it) {
+        RateLimitedRequest* request = it.value();
+        if (request->network_request != network_request) {
+            continue;
+        };
+        // An active request whose reply was dropped can't complete anyone else's.
+        if ((request == m_active_request.get()) && !request->reply) {
+            continue;
+        };
+        return request;
+    };
+    return nullptr;
+}
+
 // Send the active request at the next time it will be safe to do so
 // without violating the rate limit policy.
 void RateLimitManager::ActivateRequest() {
@@ -284,7 +379,11 @@ void RateLimitManager::ActivateRequest() {
 
     m_active_request = std::move(m_queued_requests.front());
     m_queued_requests.pop_front();
-    emit QueueUpdated(m_policy->name(), static_cast<int>(m_queued_requests.size()));
+
+    // Plan the whole batch, not just the active request, so that long windows
+    // are paced before we run into them rather than after.
+    const std::vector<QDateTime> plan = PlanSends();
+    emit QueueUpdated(m_policy->name(), static_cast<int>(m_queued_requests.size()), plan.back());
 
     const QDateTime now = QDateTime::currentDateTime();
 
@@ -295,6 +394,14 @@ void RateLimitManager::ActivateRequest() {
         return;
     };
 
+    if (next_send < plan.front()) {
+        QLOG_TRACE() << "RateLimitManager::ActivateRequest()"
+            << m_policy->name() << "pacing the active request"
+            << "(in" << now.secsTo(plan.front()) << "seconds,"
+            << "batch finishing in" << now.secsTo(plan.back()) << "seconds)";
+        next_send = plan.front();
+    };
+
     QLOG_TRACE() << "RateLimitManager::ActivateRequest()"
         << m_policy->name()
         << "next_send before adjustment is" << next_send.toString()
@@ -336,3 +443,17 @@ void RateLimitManager::ActivateRequest() {
         emit Paused(m_policy->name(), next_send);
     };
 }
+
+std::vector<QDateTime> RateLimitManager::PlanSends() {
+    const int request_count = static_cast<int>(m_queued_requests.size()) + (m_active_request ? 1 : 0);
+    m_planner = std::make_unique<RateLimitPlanner>(*m_policy, m_history, MINIMUM_INTERVAL_MSEC);
+    std::vector<QDateTime> plan;
+    plan.reserve(request_count);
+    for (int i = 0; i < request_count; ++i) {
+        plan.push_back(m_planner->PlanNext(request_count - i));
+    };
+    if (plan.empty()) {
+        plan.push_back(QDateTime::currentDateTime());
+    };
+    return plan;
+}
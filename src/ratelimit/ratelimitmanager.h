@@ -20,13 +20,16 @@
 #pragma once
 
 #include <QDateTime>
+#include <QMultiHash>
 #include <QNetworkRequest>
 #include <QObject>
 #include <QTimer>
+#include <QUrl>
 
 #include <boost/circular_buffer.hpp>
 
 #include <deque>
+#include <vector>
 
 #include "network_info.h"
 #include "ratelimit.h"
@@ -36,7 +39,9 @@ class QNetworkReply;
 
 class RateLimitedReply;
 struct RateLimitedRequest;
+class RateLimitPlanner;
 class RateLimitPolicy;
+struct RateLimitSnapshot;
 
 // Manages a single rate limit policy, which may apply to multiple endpoints.
 class RateLimitManager : public QObject {
@@ -58,6 +63,12 @@ public:
 
     void Update(QNetworkReply* reply);
 
+    // Restore the policy and reply history from a previous session.
+    void Restore(const RateLimitSnapshot& snapshot);
+
+    // Copy the policy and reply history so they can be restored later.
+    void Save(RateLimitSnapshot& snapshot) const;
+
     const RateLimitPolicy& policy();
 
     int msecToNextSend() const { return m_activation_timer.remainingTime(); };
@@ -69,8 +80,9 @@ signals:
     // Emitted when the underlying policy has been updated.
     void PolicyUpdated(const RateLimitPolicy& policy);
 
-    // Emitted when a request has been added to the queue;
-    void QueueUpdated(const QString policy_name, int queued_requests);
+    // Emitted when a request has been added to the queue, along with the
+    // time the last queued request is expected to be sent.
+    void QueueUpdated(const QString policy_name, int queued_requests, const QDateTime& estimated_finish);
 
     // Emitted when a network request has to wait to be sent.
     void Paused(const QString& policy_name, const QDateTime& until);
@@ -97,6 +109,15 @@ private:
     // request timer to send that request after a delay.
     void ActivateRequest();
 
+    // Return the active or queued request that is identical to the given
+    // network request, or nullptr if there isn't one.
+    RateLimitedRequest* FindRequest(const QNetworkRequest& network_request) const;
+
+    // Plan the send times of the active request and every queued request
+    // against all the rules of the current policy, and keep the planner so
+    // that requests queued later can be added to the plan.
+    std::vector<QDateTime> PlanSends();
+
     // Used to send requests after a delay.
     QTimer m_activation_timer;
 
@@ -111,6 +132,15 @@ private:
     // Requests that are waiting to be activated.
     std::deque<std::unique_ptr<RateLimitedRequest>> m_queued_requests;
 
+    // The active and queued requests by url, so that identical requests
+    // can be found without comparing every request in the queue.
+    QMultiHash<QUrl, RateLimitedRequest*> m_requests_by_url;
+
+    // Plans the send times of requests as they are queued. It's reset when
+    // the policy or the history changes, and the whole queue is planned
+    // again when the next request is activated.
+    std::unique_ptr<RateLimitPlanner> m_planner;
+
     // We use a history of the received reply times so that we can calculate
     // when the next safe send time will be. This allows us to calculate the
     // least delay necessary to stay compliant.
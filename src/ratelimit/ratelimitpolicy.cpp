@@ -23,11 +23,14 @@
 #include <QDateTime>
 #include <QNetworkReply>
 
+#include <algorithm>
+
 #include <QsLog/QsLog.h>
 
 #include "util/util.h"
 
 #include "ratelimit.h"
+#include "ratelimitsnapshot.h"
 
 //=========================================================================================
 // RateLimitData
@@ -44,6 +47,10 @@ RateLimitData::RateLimitData(const QByteArray& header_fragment)
     m_restriction = parts[2].toInt();
 }
 
+QByteArray RateLimitData::fragment() const {
+    return QByteArray::number(m_hits) + ":" + QByteArray::number(m_period) + ":" + QByteArray::number(m_restriction);
+}
+
 //=========================================================================================
 // RateLimitItem
 //=========================================================================================
@@ -110,38 +117,68 @@ QDateTime RateLimitItem::GetNextSafeSend(const boost::circular_buffer<QDateTime>
     return next_send;
 }
 
-int RateLimitItem::EstimateDuration(int request_count, int minimum_delay_msec) const {
-    QLOG_TRACE() << "RateLimit::RuleItem::EstimateDuration() entered";
+std::deque<QDateTime> RateLimitItem::GetTimeline(const boost::circular_buffer<QDateTime>& history, const QDateTime& now) const {
+    QLOG_TRACE() << "RateLimit::RuleItem::GetTimeline() entered";
 
-    int duration = 0;
+    const QDateTime window_start = now.addSecs(-m_limit.period());
 
-    const int current_hits = m_state.hits();
-    const int max_hits = m_limit.hits();
-    const int period_length = m_limit.period();
-    const int restriction = m_limit.restriction();
+    // Collect the known replies that still count against this item, oldest first.
+    // The history is ordered with the most recent reply at the front.
+    std::deque<QDateTime> timeline;
+    for (const auto& t : history) {
+        if (t <= window_start) {
+            break;
+        };
+        timeline.push_front(t);
+    };
 
-    int initial_burst = max_hits - current_hits;
-    if (initial_burst < 0) {
-        initial_burst = 0;
-        duration += restriction;
+    // The server may be counting hits we never saw, e.g. HEAD requests or
+    // another tool using the same account. Those hits were reported as of the
+    // most recent reply, so we assume they happened then, which means they
+    // will expire as late as possible.
+    const QDateTime reported = history.empty() ? now : history.front();
+    if (reported > window_start) {
+        int missing = m_state.hits() - static_cast<int>(timeline.size());
+        while (missing-- > 0) {
+            timeline.push_back(reported);
+        };
     };
+    return timeline;
+}
+
+QDateTime RateLimitItem::GetNextPlannedSend(std::deque<QDateTime>& timeline, const QDateTime& send, int remaining_requests) const {
+
+    const qint64 period_msec = 1000 * qint64(m_limit.period());
+    const int max_hits = m_limit.hits();
 
-    int remaining_requests = request_count - initial_burst;
-    if (remaining_requests < 0) {
-        remaining_requests = 0;
+    // Forget hits that will have left the window by the proposed send time.
+    while (!timeline.empty() && (timeline.front().msecsTo(send) >= period_msec)) {
+        timeline.pop_front();
     };
 
-    const int full_periods = (remaining_requests / max_hits);
-    const int final_burst = (remaining_requests % max_hits);
+    QDateTime next_send = send;
 
-    const int a = initial_burst * minimum_delay_msec;
-    const int b = full_periods * period_length * 1000;
-    const int c = final_burst * minimum_delay_msec;
-    const int total_msec = a + b + c;
+    // Wait for enough hits to expire that this send will not exceed the limit.
+    if ((max_hits > 0) && (static_cast<int>(timeline.size()) >= max_hits)) {
+        const QDateTime t = timeline[timeline.size() - max_hits].addMSecs(period_msec);
+        if (next_send < t) {
+            next_send = t;
+        };
+    };
 
-    duration += (total_msec / 1000);
+    // If the remaining requests cannot all fit within this window, then sending
+    // them in a burst would only take us to the limit and force a long wait. Pace
+    // them evenly instead, leaving one hit of headroom so the policy never
+    // becomes borderline, which is when we risk a violation and a restriction.
+    if (!timeline.empty() && (static_cast<int>(timeline.size()) + remaining_requests > max_hits)) {
+        const qint64 interval_msec = period_msec / std::max(1, max_hits - 1);
+        const QDateTime t = timeline.back().addMSecs(interval_msec);
+        if (next_send < t) {
+            next_send = t;
+        };
+    };
 
-    return duration;
+    return next_send;
 }
 
 //=========================================================================================
@@ -149,13 +186,20 @@ int RateLimitItem::EstimateDuration(int request_count, int minimum_delay_msec) c
 //=========================================================================================
 
 RateLimitRule::RateLimitRule(const QByteArray& name, QNetworkReply* const reply)
+    : RateLimitRule(name,
+        RateLimit::ParseRateLimit(reply, name),
+        RateLimit::ParseRateLimitState(reply, name))
+{}
+
+RateLimitRule::RateLimitRule(
+    const QByteArray& name,
+    const QByteArrayList& limit_fragments,
+    const QByteArrayList& state_fragments)
     : m_name(name)
     , m_status(RateLimitPolicy::Status::UNKNOWN)
     , m_maximum_hits(-1)
 {
     QLOG_TRACE() << "RateLimit::PolicyRule::PolicyRule() entered";
-    const QByteArrayList limit_fragments = RateLimit::ParseRateLimit(reply, name);
-    const QByteArrayList state_fragments = RateLimit::ParseRateLimitState(reply, name);
     const int item_count = limit_fragments.size();
     if (state_fragments.size() != limit_fragments.size()) {
         QLOG_ERROR() << "Invalid data for policy role.";
@@ -225,7 +269,29 @@ RateLimitPolicy::RateLimitPolicy(QNetworkReply* const reply)
     for (const auto& rule_name : rule_names) {
 
         // Create a new rule and add it to the list.
-        const auto& rule = m_rules.emplace_back(rule_name, reply);
+        m_rules.emplace_back(rule_name, reply);
+    };
+    UpdateStatus();
+}
+
+RateLimitPolicy::RateLimitPolicy(const RateLimitSnapshot& snapshot)
+    : m_name(snapshot.policy)
+    , m_status(RateLimitPolicy::Status::UNKNOWN)
+    , m_maximum_hits(0)
+{
+    QLOG_TRACE() << "RateLimit::Policy::Policy() entered for a saved policy";
+    m_rules.reserve(snapshot.rules.size());
+    for (const auto& rule : snapshot.rules) {
+        m_rules.emplace_back(
+            rule.name.toUtf8(),
+            rule.limit.toUtf8().split(','),
+            rule.state.toUtf8().split(','));
+    };
+    UpdateStatus();
+}
+
+void RateLimitPolicy::UpdateStatus() {
+    for (const auto& rule : m_rules) {
 
         // Check the status of this rule..
         if (rule.status() >= RateLimitPolicy::Status::VIOLATION) {
@@ -246,6 +312,24 @@ RateLimitPolicy::RateLimitPolicy(QNetworkReply* const reply)
     };
 }
 
+void RateLimitPolicy::Save(RateLimitSnapshot& snapshot) const {
+    snapshot.policy = m_name;
+    snapshot.rules.clear();
+    snapshot.rules.reserve(m_rules.size());
+    for (const auto& rule : m_rules) {
+        QByteArrayList limits;
+        QByteArrayList states;
+        for (const auto& item : rule.items()) {
+            limits.append(item.limit().fragment());
+            states.append(item.state().fragment());
+        };
+        auto& saved_rule = snapshot.rules.emplace_back();
+        saved_rule.name = rule.name();
+        saved_rule.limit = QString::fromUtf8(limits.join(','));
+        saved_rule.state = QString::fromUtf8(states.join(','));
+    };
+}
+
 void RateLimitPolicy::Check(const RateLimitPolicy& other) const {
     QLOG_TRACE() << "RateLimit::Policy::Check() entered";
 
@@ -294,17 +378,75 @@ QDateTime RateLimitPolicy::GetNextSafeSend(const boost::circular_buffer<QDateTim
     return next_send;
 }
 
-QDateTime RateLimitPolicy::EstimateDuration(int num_requests, int minimum_delay_msec) const {
-    QLOG_TRACE() << "RateLimit::Policy::EstimateDuration() entered";
+std::vector<QDateTime> RateLimitPolicy::PlanSends(
+    const boost::circular_buffer<QDateTime>& history,
+    int request_count,
+    int minimum_delay_msec) const
+{
+    QLOG_TRACE() << "RateLimit::Policy::PlanSends() entered";
 
-    int longest_wait = 0;
-    for (const auto& rule : m_rules) {
+    RateLimitPlanner planner(*this, history, minimum_delay_msec);
+    std::vector<QDateTime> plan;
+    plan.reserve(request_count);
+    for (int i = 0; i < request_count; ++i) {
+        plan.push_back(planner.PlanNext(request_count - i));
+    };
+    return plan;
+}
+
+//=========================================================================================
+// RateLimitPlanner
+//=========================================================================================
+
+RateLimitPlanner::RateLimitPlanner(
+    const RateLimitPolicy& policy,
+    const boost::circular_buffer<QDateTime>& history,
+    int minimum_delay_msec)
+    : m_minimum_delay_msec(minimum_delay_msec)
+{
+    const QDateTime now = QDateTime::currentDateTime().toLocalTime();
+
+    // Build a timeline of the hits that count against each item of every rule.
+    for (const auto& rule : policy.rules()) {
         for (const auto& item : rule.items()) {
-            const int wait = item.EstimateDuration(num_requests, minimum_delay_msec);
-            if (longest_wait < wait) {
-                longest_wait = wait;
+            m_items.push_back(&item);
+            m_timelines.push_back(item.GetTimeline(history, now));
+        };
+    };
+
+    // Nothing can be sent until any active restriction has been lifted.
+    m_next_send = now;
+    const QDateTime reported = history.empty() ? now : history.front();
+    for (const auto* item : m_items) {
+        const int restriction = item->state().restriction();
+        if (restriction > 0) {
+            const QDateTime t = reported.addSecs(restriction);
+            if (m_next_send < t) {
+                m_next_send = t;
             };
         };
     };
-    return QDateTime::currentDateTime().toLocalTime().addSecs(longest_wait);
+}
+
+QDateTime RateLimitPlanner::PlanNext(int remaining_requests) {
+
+    // Plan the request at the earliest time every item will allow it, then
+    // add it to every timeline so it counts against the requests behind it.
+    bool delayed = true;
+    while (delayed) {
+        delayed = false;
+        for (size_t k = 0; k < m_items.size(); ++k) {
+            const QDateTime t = m_items[k]->GetNextPlannedSend(m_timelines[k], m_next_send, remaining_requests);
+            if (m_next_send < t) {
+                m_next_send = t;
+                delayed = true;
+            };
+        };
+    };
+    const QDateTime send = m_next_send;
+    for (auto& timeline : m_timelines) {
+        timeline.push_back(send);
+    };
+    m_next_send = send.addMSecs(m_minimum_delay_msec);
+    return send;
 }
@@ -21,13 +21,15 @@
 
 #include <boost/circular_buffer.hpp>
 
+#include <QByteArrayList>
+#include <QDateTime>
 #include <QMetaObject>
 #include <QString>
 
+#include <deque>
 #include <vector>
 
 class QByteArray;
-class QDateTime;
 class QNetworkReply;
 
 //=========================================================================================
@@ -55,6 +57,7 @@ class QNetworkReply;
 // all of limitations for each item of every rule within that policy are checked.
 
 class RateLimitRule;
+struct RateLimitSnapshot;
 
 class RateLimitPolicy {
     Q_GADGET
@@ -63,14 +66,17 @@ public:
     Q_ENUM(Status)
 
     RateLimitPolicy(QNetworkReply* const reply);
+    RateLimitPolicy(const RateLimitSnapshot& snapshot);
     void Check(const RateLimitPolicy& other) const;
     const QString& name() const { return m_name; };
     const std::vector<RateLimitRule>& rules() const { return m_rules; };
     Status status() const { return m_status; };
     int maximum_hits() const { return m_maximum_hits; };
     QDateTime GetNextSafeSend(const boost::circular_buffer<QDateTime>& history);
-    QDateTime EstimateDuration(int request_count, int minimum_delay_msec) const;
+    std::vector<QDateTime> PlanSends(const boost::circular_buffer<QDateTime>& history, int request_count, int minimum_delay_msec) const;
+    void Save(RateLimitSnapshot& snapshot) const;
 private:
+    void UpdateStatus();
     const QString m_name;
     std::vector<RateLimitRule> m_rules;
     Status m_status;
@@ -81,6 +87,7 @@ private:
 class RateLimitData {
 public:
     RateLimitData(const QByteArray& header_fragment);
+    QByteArray fragment() const;
     int hits() const { return m_hits; };
     int period() const { return m_period; };
     int restriction() const { return m_restriction; };
@@ -98,7 +105,8 @@ public:
     const RateLimitData& state() const { return m_state; };
     RateLimitPolicy::Status status() const { return m_status; };
     QDateTime GetNextSafeSend(const boost::circular_buffer<QDateTime>& history) const;
-    int EstimateDuration(int request_count, int minimum_delay_msec) const;
+    std::deque<QDateTime> GetTimeline(const boost::circular_buffer<QDateTime>& history, const QDateTime& now) const;
+    QDateTime GetNextPlannedSend(std::deque<QDateTime>& timeline, const QDateTime& send, int remaining_requests) const;
 private:
     RateLimitData m_limit;
     RateLimitData m_state;
@@ -108,6 +116,7 @@ private:
 class RateLimitRule {
 public:
     RateLimitRule(const QByteArray& name, QNetworkReply* const reply);
+    RateLimitRule(const QByteArray& name, const QByteArrayList& limit_fragments, const QByteArrayList& state_fragments);
     void Check(const RateLimitRule& other, const QString& prefix) const;
     const QString& name() const { return m_name; };
     const std::vector<RateLimitItem>& items() const { return m_items; };
@@ -119,3 +128,20 @@ private:
     RateLimitPolicy::Status m_status;
     int m_maximum_hits;
 };
+
+// Plans the send times of a queue of requests one request at a time, so that
+// a request added to the end of the queue can be planned without planning the
+// whole queue again. The policy must outlive the planner.
+class RateLimitPlanner {
+public:
+    RateLimitPlanner(const RateLimitPolicy& policy, const boost::circular_buffer<QDateTime>& history, int minimum_delay_msec);
+
+    // Plan the next send, given how many requests are left to plan,
+    // including this one.
+    QDateTime PlanNext(int remaining_requests);
+private:
+    const int m_minimum_delay_msec;
+    std::vector<const RateLimitItem*> m_items;
+    std::vector<std::deque<QDateTime>> m_timelines;
+    QDateTime m_next_send;
+};
@@ -0,0 +1,46 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QString>
+
+#include <vector>
+
+#include <json_struct/json_struct_qt.h>
+
+// A serializable copy of a rate limit policy, the endpoints it applies to,
+// and the recent reply history. This is saved to the data store so that the
+// rate limiter can resume pacing requests correctly after a restart without
+// having to send HEAD requests to rediscover each policy.
+struct RateLimitSnapshot {
+
+    struct Rule {
+        QString name;
+        QString limit; // Same format as the X-Rate-Limit-<rule> header
+        QString state; // Same format as the X-Rate-Limit-<rule>-State header
+        JS_OBJ(name, limit, state);
+    };
+
+    QString policy;
+    std::vector<QString> endpoints;
+    std::vector<Rule> rules;
+    std::vector<long long> history; // Reply times in msecs since epoch, most recent first
+    JS_OBJ(policy, endpoints, rules, history);
+};
@@ -19,9 +19,13 @@
 
 #include "search.h"
 
+#include <QElapsedTimer>
 #include <QHeaderView>
+#include <QItemSelectionModel>
 #include <QTreeView>
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
 
 #include <QsLog/QsLog.h>
@@ -32,6 +36,7 @@
 #include "bucket.h"
 #include "column.h"
 #include "filters.h"
+#include "itemindex.h"
 #include "items_model.h"
 
 Search::Search(
@@ -41,12 +46,16 @@ Search::Search(
     QTreeView* view)
     : m_bo_manager(bo_manager)
     , m_view(*view)
+    , m_column_cache(bo_manager, m_columns)
     , m_model(bo_manager, *this)
+    , m_table_model(m_model, *this)
     , m_caption(caption)
     , m_filtered(false)
     , m_filtered_item_count(0)
     , m_current_mode(ViewMode::ByTab)
     , m_refresh_reason(RefreshReason::Unknown)
+    , m_item_rows_valid(false)
+    , m_generation(0)
 {
     using move_only = std::unique_ptr<Column>;
     move_only init[] = {
@@ -84,6 +93,9 @@ Search::Search(
     for (auto& filter : filters) {
         m_filters.emplace_back(filter->CreateData());
     };
+
+    // There is always exactly one "By Item" bucket.
+    m_bucket_by_item.emplace_back(ItemLocation());
 }
 
 void Search::FromForm() {
@@ -144,49 +156,111 @@ const Bucket& Search::bucket(int row) const {
     return bucket_list[row];
 }
 
+QAbstractItemModel* Search::model() {
+    if (m_current_mode == ViewMode::ByItem) {
+        return &m_table_model;
+    };
+    return &m_model;
+}
+
 const QModelIndex Search::index(const std::shared_ptr<Item>& item) const {
     if (!item) {
         // Return an invalid index because there is no current item.
         return QModelIndex();
     };
-    // Look for a bucket that matches the item's location.
-    const auto& bucket_list = buckets();
-    const auto& location_id = item->location().get_tab_uniq_id();
-    const int bucket_count = static_cast<int>(bucket_list.size());
-    for (int row = 0; row < bucket_count; ++row) {
-        // Check each search bucket against the item's location.
-        const auto& bucket = bucket_list[row];
-        const auto& bucket_id = bucket.location().get_tab_uniq_id();
-        if (location_id == bucket_id) {
-            // Check each item in the bucket.
-            const QModelIndex parent = m_model.index(row);
-            const auto& items = bucket.items();
-            const int item_count = static_cast<int>(items.size());
-            for (int n = 0; n < item_count; ++n) {
-                const auto& model_item = items[n];
-                if (item == model_item) {
-                    // Found the index of a match.
-                    return m_model.index(n, 0, parent);
-                };
-            };
+    if (m_current_mode == ViewMode::ByItem) {
+        // The rows are only updated when the table is sorted, so make sure
+        // the item is still there.
+        const int row = m_table_model.row(*item);
+        if ((row < 0) || (m_table_model.item(row) != item)) {
+            return QModelIndex();
+        };
+        return m_table_model.index(row, 0);
+    };
+    if (!m_item_rows_valid) {
+        UpdateItemRows();
+    };
+    const auto it = m_item_rows.find(item.get());
+    if (it == m_item_rows.end()) {
+        // If we get here, that means the previously selected item is no
+        // longer part of the current view.
+        return QModelIndex();
+    };
+    const auto [bucket_row, item_row] = it->second;
+    const QModelIndex parent = m_model.index(bucket_row);
+    return m_model.index(item_row, 0, parent);
+}
+
+void Search::UpdateItemRows() const {
+    m_item_rows.clear();
+    m_item_rows.reserve(m_items.size());
+    const int bucket_count = static_cast<int>(m_bucket_by_tab.size());
+    for (int bucket_row = 0; bucket_row < bucket_count; ++bucket_row) {
+        const auto& items = m_bucket_by_tab[bucket_row].items();
+        const int item_count = static_cast<int>(items.size());
+        for (int item_row = 0; item_row < item_count; ++item_row) {
+            m_item_rows[items[item_row].get()] = { bucket_row, item_row };
+        };
+    };
+    m_item_rows_valid = true;
+}
+
+std::shared_ptr<Item> Search::item(const QModelIndex& index) const {
+    if (!index.isValid()) {
+        return nullptr;
+    };
+    if (index.model() == &m_table_model) {
+        return m_table_model.item(index.row());
+    };
+    if (index.internalId() == 0) {
+        // This is a tab row.
+        return nullptr;
+    };
+    const int bucket_row = index.parent().row();
+    if (!has_bucket(bucket_row)) {
+        QLOG_WARN() << "Search::item(): parent bucket" << bucket_row << "does not exist";
+        return nullptr;
+    };
+    const Bucket& b = bucket(bucket_row);
+    const int item_row = index.row();
+    if (!b.has_item(item_row)) {
+        QLOG_WARN() << "Search::item(): parent bucket" << bucket_row << "does not have" << item_row << "items";
+        return nullptr;
+    };
+    return b.item(item_row);
+}
+
+void Search::ItemsChanged(const QModelIndexList& indices) {
+    if (m_current_mode == ViewMode::ByItem) {
+        std::vector<int> rows;
+        rows.reserve(indices.size());
+        for (const auto& index : indices) {
+            rows.push_back(index.row());
+        };
+        m_table_model.RowsChanged(std::move(rows));
+    } else {
+        const int last_column = static_cast<int>(m_columns.size()) - 1;
+        for (const auto& index : indices) {
+            emit m_model.dataChanged(index.siblingAtColumn(0), index.siblingAtColumn(last_column));
         };
     };
-    // If we get here, that means the previously selected item is no
-    // longer part of the current view.
-    return QModelIndex();
+}
+
+QVariant Search::CellData(const Item& item, int column, int role) const {
+    return m_column_cache.data(item, column, role);
 }
 
 void Search::Sort(int column, Qt::SortOrder order) {
     const int column_count = static_cast<int>(m_columns.size());
     if ((column >= 0) && (column < column_count)) {
-        auto& col = *m_columns[column];
-        for (auto& bucket : active_buckets()) {
-            bucket.Sort(col, order);
+        Bucket::SortAll(active_buckets(), *m_columns[column], order);
+        if (m_current_mode == ViewMode::ByTab) {
+            m_item_rows_valid = false;
         };
     };
 }
 
-void Search::FilterItems(const Items& items) {
+void Search::FilterItems(const Items& items, const ItemIndex& index) {
 
     QLOG_DEBUG() << "FilterItems: reason(" << m_refresh_reason << ")";
 
@@ -195,84 +269,336 @@ void Search::FilterItems(const Items& items) {
         return;
     };
 
-    // Create a temporary vector of only the filters that are
-    // active, so we don't have to check every filter against
-    // every item.
-    std::vector<FilterData*> active_filters;
-    active_filters.reserve(m_filters.size());
+    const auto job = CreateJob(items, index);
+    job->Run();
+    FinishJob(*job);
+}
+
+std::shared_ptr<SearchJob> Search::CreateJob(const Items& items, const ItemIndex& index) {
+
+    auto job = std::make_shared<SearchJob>(items, index);
+
+    // When only the items changed since the last search, the previous results
+    // are still valid for items that were already there, so only the items
+    // added by the refresh need to be checked.
+    job->m_use_index = index.IsBuiltFrom(items);
+    job->m_incremental = job->m_use_index
+        && (m_refresh_reason == RefreshReason::ItemsChanged)
+        && (m_generation > 0)
+        && (m_generation + 1 == index.generation());
     for (auto& filter : m_filters) {
-        if (filter->filter()->IsActive()) {
-            active_filters.push_back(filter.get());
+        if (filter->filter()->IsActive() && !filter->filter()->IsCacheable()) {
+            job->m_incremental = false;
+        };
+    };
+    QLOG_DEBUG() << "FilterItems: incremental(" << job->m_incremental << ")";
+
+    // Take a snapshot of the active filters, and how they performed in past
+    // searches, because both can change while the job runs.
+    for (auto& filter : m_filters) {
+        if (!filter->filter()->IsActive()) {
+            continue;
+        };
+        SearchJob::FilterRun run{ *filter, filter->filter()->statistics().Rank(), 0, 0, 0 };
+        if (filter->filter()->IsCacheable()) {
+            job->m_filters.push_back(std::move(run));
+        } else {
+            job->m_local_filters.push_back(std::move(run));
+        };
+    };
+
+    if (job->m_incremental) {
+        job->m_previous_matches = m_matches;
+    } else {
+        // The previous results don't match the search form any more.
+        m_matches = ItemBitmap();
+        m_generation = 0;
+    };
+    return job;
+}
+
+void Search::FinishJob(SearchJob& job) {
+
+    std::vector<size_t>& candidates = job.m_matches;
+
+    // Check the filters that couldn't run with the job.
+    for (auto& run : job.m_local_filters) {
+        job.CheckItems(run, candidates);
+    };
+
+    // Update the statistics used to plan the next search.
+    for (auto* runs : { &job.m_filters, &job.m_local_filters }) {
+        for (auto& run : *runs) {
+            if (run.evaluated > 0) {
+                run.data.filter()->statistics().Record(run.evaluated, run.passed, run.elapsed);
+            };
+        };
+    };
+
+    // Remember the results for the next refresh.
+    if (job.m_use_index) {
+        m_matches = ItemBitmap(job.m_items.size());
+        for (const auto position : candidates) {
+            m_matches.Set(position);
         };
+        m_generation = job.m_index.generation();
+    } else {
+        m_matches = ItemBitmap();
+        m_generation = 0;
+    };
+
+    UpdateBuckets(job.m_items, candidates, job.m_index, job.m_use_index, job.m_incremental);
+}
+
+SearchJob::SearchJob(const Items& items, const ItemIndex& index)
+    : m_items(items)
+    , m_index(index)
+    , m_use_index(false)
+    , m_incremental(false)
+    , m_cancelled(false)
+{}
+
+void SearchJob::Run() {
+
+    // Filters that can use the index narrow the search down to a sorted list
+    // of candidate positions; the other active filters are collected into a
+    // temporary vector and checked against the candidates afterwards.
+    bool use_candidates = false;
+    bool use_bitmap = false;
+    std::vector<size_t> candidates;
+    ItemBitmap bitmap;
+    std::vector<FilterRun*> active_filters;
+    active_filters.reserve(m_filters.size());
+    for (auto& run : m_filters) {
+        if (m_cancelled) {
+            return;
+        };
+        std::vector<size_t> positions;
+        ItemBitmap filter_bitmap;
+        if (m_use_index && run.data.FindBitmap(m_index, &filter_bitmap)) {
+            if (use_bitmap) {
+                bitmap &= filter_bitmap;
+            } else {
+                bitmap = std::move(filter_bitmap);
+                use_bitmap = true;
+            };
+        } else if (m_use_index && run.data.FindCandidates(m_index, &positions)) {
+            if (use_candidates) {
+                std::vector<size_t> intersection;
+                std::set_intersection(
+                    candidates.begin(), candidates.end(),
+                    positions.begin(), positions.end(),
+                    std::back_inserter(intersection));
+                candidates.swap(intersection);
+            } else {
+                candidates.swap(positions);
+                use_candidates = true;
+            };
+        } else {
+            active_filters.push_back(&run);
+        };
+    };
+
+    // Combine the attribute bitmaps with any candidate lists.
+    if (use_bitmap) {
+        if (use_candidates) {
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                [&](size_t position) { return !bitmap.Test(position); }),
+                candidates.end());
+        } else {
+            candidates = bitmap.Positions();
+            use_candidates = true;
+        };
+    };
+    if (m_incremental) {
+        if (use_candidates) {
+            std::vector<size_t> intersection;
+            std::set_intersection(
+                candidates.begin(), candidates.end(),
+                m_index.added().begin(), m_index.added().end(),
+                std::back_inserter(intersection));
+            candidates.swap(intersection);
+        } else {
+            candidates = m_index.added();
+        };
+    } else if (!use_candidates) {
+        candidates.resize(m_items.size());
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            candidates[i] = i;
+        };
+    };
+
+    // Run the remaining filters one at a time over the shrinking list of
+    // candidates, starting with the ones expected to reject the most items
+    // for the least time. Timing each filter as a whole is cheap, and the
+    // results are used to plan the next search.
+    std::sort(active_filters.begin(), active_filters.end(),
+        [](FilterRun* a, FilterRun* b) { return a->rank < b->rank; });
+    for (auto* run : active_filters) {
+        if (candidates.empty()) {
+            break;
+        };
+        CheckItems(*run, candidates);
+        if (m_cancelled) {
+            return;
+        };
+    };
+
+    // Splice the new matches into the ones kept from the last search.
+    if (m_incremental) {
+        std::vector<size_t> kept;
+        for (size_t i = 0; i < m_items.size(); ++i) {
+            const size_t previous = m_index.previous_position(i);
+            if ((previous != ItemIndex::npos) && m_previous_matches.Test(previous)) {
+                kept.push_back(i);
+            };
+        };
+        std::vector<size_t> merged;
+        merged.reserve(kept.size() + candidates.size());
+        std::merge(
+            kept.begin(), kept.end(),
+            candidates.begin(), candidates.end(),
+            std::back_inserter(merged));
+        candidates.swap(merged);
     };
-    active_filters.shrink_to_fit();
 
-    // Reset everything before starting to filter items.
+    m_matches.swap(candidates);
+}
+
+void SearchJob::CheckItems(FilterRun& run, std::vector<size_t>& candidates) const {
+    // Check for cancellation every so often, so that a search that's no
+    // longer wanted doesn't hold up the next one.
+    constexpr size_t CANCEL_CHECK_INTERVAL = 4096;
+    QElapsedTimer timer;
+    timer.start();
+    const size_t evaluated = candidates.size();
+    size_t kept = 0;
+    for (size_t i = 0; i < evaluated; ++i) {
+        if ((i % CANCEL_CHECK_INTERVAL == 0) && m_cancelled) {
+            return;
+        };
+        if (run.data.Matches(m_items[candidates[i]])) {
+            candidates[kept++] = candidates[i];
+        };
+    };
+    candidates.resize(kept);
+    run.evaluated += evaluated;
+    run.passed += kept;
+    run.elapsed += timer.nsecsElapsed();
+}
+
+void Search::UpdateBuckets(const Items& items, const std::vector<size_t>& matches, const ItemIndex& index, bool use_index, bool incremental) {
+
+    // Reset everything before adding the matching items.
+    m_column_cache.Clear();
     m_items.clear();
-    m_filtered = false;
+    m_items.reserve(matches.size());
+    m_filtered = (matches.size() < items.size());
     m_filtered_item_count = 0;
 
     // A single bucket with null location is used to view all items at once.
-    m_bucket_by_item.clear();
-    m_bucket_by_item.emplace_back(ItemLocation());
+    m_bucket_by_item.front() = Bucket(ItemLocation());
+    m_bucket_by_item.front().Reserve(matches.size());
+
+    // Tabs are numbered in location order, so the "By Tab" buckets can be
+    // filled by number without comparing locations. The index has these
+    // numbers, unless it wasn't built from the items being searched.
+    std::vector<ItemLocation> unindexed_tabs;
+    std::vector<quint32> unindexed_item_tabs;
+    if (!use_index) {
+        ItemIndex::NumberTabs(items, unindexed_tabs, unindexed_item_tabs);
+    };
+    const std::vector<ItemLocation>& tabs = use_index ? index.tabs() : unindexed_tabs;
+    const auto tab = [&](size_t position) -> size_t {
+        return use_index ? index.tab(position) : unindexed_item_tabs[position];
+    };
+    const auto find_tab = [&](const ItemLocation& location) {
+        const auto it = std::lower_bound(tabs.begin(), tabs.end(), location);
+        return ((it != tabs.end()) && !(location < *it)) ? static_cast<size_t>(it - tabs.begin()) : tabs.size();
+    };
 
-    // Temporarily store items-by-tabs in a map.
-    std::map<ItemLocation, Bucket> bucketed_tabs;
-
-    // Try to minimize the number of times we have to loop over each item,
-    // because some players have hundreds of thousands or millions of items.
-    for (const auto& item : items) {
-        // Start by assuming there is a match and run through evey
-        // filter until we find that one that will filter out the
-        // current item.
-        bool matches = true;
-        for (const auto& filter : active_filters) {
-            if (!filter->Matches(item)) {
-                // Now that we know this item will be filtered out,
-                // we don't need to check any more filters.
-                matches = false;
-                m_filtered = true;
-                break;
+    // After an incremental update, tabs that weren't refreshed have exactly the
+    // same matching items as before, so their buckets can be kept as they are.
+    std::vector<Bucket> tab_buckets(tabs.size());
+    std::vector<bool> kept(tabs.size(), false);
+    if (incremental) {
+        for (auto& bucket : m_bucket_by_tab) {
+            const size_t id = find_tab(bucket.location());
+            if (!bucket.items().empty() && (id < tabs.size()) && !index.tab_changed(id)) {
+                tab_buckets[id] = std::move(bucket);
+                kept[id] = true;
             };
         };
-        if (matches) {
-            // This item passed through all the filters, so we can
-            // add it to the list of items and total count.
-            m_items.push_back(item);
-            m_filtered_item_count += item->count();
+    };
 
-            // Add this item to the "By Item" bucket.
-            m_bucket_by_item.front().AddItem(item);
+    // Count the matching items in each tab first so that each bucket
+    // is only allocated once.
+    std::vector<size_t> counts(tabs.size(), 0);
+    for (const auto position : matches) {
+        ++counts[tab(position)];
+    };
+    for (size_t id = 0; id < tabs.size(); ++id) {
+        if ((counts[id] > 0) && !kept[id]) {
+            tab_buckets[id] = Bucket(tabs[id]);
+            tab_buckets[id].Reserve(counts[id]);
+        };
+    };
 
-            // Add this item to the associagted "By Tab" bucket.
-            const ItemLocation location = item->location();
-            if (!bucketed_tabs.count(location)) {
-                bucketed_tabs[location] = Bucket(location);
-            };
-            bucketed_tabs[location].AddItem(item);
+    for (const auto position : matches) {
+        // This item passed through all the filters, so we can
+        // add it to the list of items and total count.
+        const auto& item = items[position];
+        m_items.push_back(item);
+        m_filtered_item_count += item->count();
+
+        // Add this item to the "By Item" bucket.
+        m_bucket_by_item.front().AddItem(item);
+
+        // Add this item to the associated "By Tab" bucket, unless
+        // the bucket was kept from the last search.
+        const size_t id = tab(position);
+        if (!kept[id]) {
+            tab_buckets[id].AddItem(item);
         };
     };
 
     // We need to add empty tabs here as there are no items to force their addition
     // But only do so if no filters are active as we want to hide empty tabs when
     // filtering
+    std::vector<ItemLocation> empty_tabs;
     if (!m_filtered) {
-        for (auto& location : m_bo_manager.GetStashTabLocations()) {
-            if (!bucketed_tabs.count(location)) {
-                bucketed_tabs[location] = Bucket(location);
+        for (const auto& location : m_bo_manager.GetStashTabLocations()) {
+            if (find_tab(location) == tabs.size()) {
+                empty_tabs.push_back(location);
             };
         };
+        std::sort(empty_tabs.begin(), empty_tabs.end());
+        empty_tabs.erase(std::unique(empty_tabs.begin(), empty_tabs.end(),
+            [](const ItemLocation& lhs, const ItemLocation& rhs) { return !(lhs < rhs) && !(rhs < lhs); }),
+            empty_tabs.end());
     };
 
-    // Move the "By Tab" buckets into their final location.
+    // Move the "By Tab" buckets into their final location, placing
+    // the empty tabs between them in location order.
     m_bucket_by_tab.clear();
-    m_bucket_by_tab.reserve(bucketed_tabs.size());
-    for (auto& element : bucketed_tabs) {
-        m_bucket_by_tab.emplace_back(std::move(element.second));
+    m_bucket_by_tab.reserve(tabs.size() + empty_tabs.size());
+    auto empty_tab = empty_tabs.begin();
+    for (size_t id = 0; id < tabs.size(); ++id) {
+        if (tab_buckets[id].items().empty()) {
+            continue;
+        };
+        for (; (empty_tab != empty_tabs.end()) && (*empty_tab < tabs[id]); ++empty_tab) {
+            m_bucket_by_tab.emplace_back(*empty_tab);
+        };
+        m_bucket_by_tab.push_back(std::move(tab_buckets[id]));
+    };
+    for (; empty_tab != empty_tabs.end(); ++empty_tab) {
+        m_bucket_by_tab.emplace_back(*empty_tab);
     };
 
     // Let the model know that current sort order has been invalidated
     m_model.SetSorted(false);
+    m_item_rows_valid = false;
 }
 
 void Search::RenameCaption(const QString& newName) {
@@ -287,7 +613,14 @@ ItemLocation Search::GetTabLocation(const QModelIndex& index) const {
     if (!index.isValid()) {
         return ItemLocation();
     };
-    if (index.internalId() > 0) {
+    if (index.model() == &m_table_model) {
+        // Every row of the flat "By Item" view is an item.
+        const auto item = m_table_model.item(index.row());
+        if (item) {
+            return item->location();
+        };
+        QLOG_WARN() << "GetTabLocation(): item row" << index.row() << "does not exist";
+    } else if (index.internalId() > 0) {
         // If index represents an item, get location from item as view may be on 'item' view
         // where bucket location doesn't match items location
         const int bucket_row = index.parent().row();
@@ -327,19 +660,43 @@ void Search::SetViewMode(ViewMode mode) {
         m_model.SetSorted(false);
         m_model.sort();
         m_model.blockSignals(false);
+        m_table_model.UpdateRows();
 
+        SetViewModel();
         RestoreViewProperties();
     };
 }
 
-void Search::Activate(const Items& items) {
+void Search::Activate(const Items& items, const ItemIndex& index) {
     FromForm();
-    FilterItems(items);
+    FilterItems(items, index);
+    ShowResults();
+}
+
+void Search::ShowResults() {
+    SetViewModel();
+    RestoreViewProperties();
+}
+
+void Search::SetViewModel() {
+    QAbstractItemModel* const active_model = model();
+    if (m_view.model() != active_model) {
+        // The view doesn't delete the selection model it made for the
+        // previous model.
+        QItemSelectionModel* const selection_model = m_view.selectionModel();
+        m_view.setModel(active_model);
+        if (selection_model) {
+            selection_model->deleteLater();
+        };
+    };
+    // The flat table has no tab rows to decorate, and telling the view that
+    // every row has the same height lets it skip measuring each one.
+    const bool flat = (m_current_mode == ViewMode::ByItem);
+    m_view.setRootIsDecorated(!flat);
+    m_view.setUniformRowHeights(flat);
     m_view.setSortingEnabled(false);
-    m_view.setModel(&m_model);
     m_view.header()->setSortIndicator(m_model.GetSortColumn(), m_model.GetSortOrder());
     m_view.setSortingEnabled(true);
-    RestoreViewProperties();
 }
 
 void Search::SaveViewProperties() {
@@ -360,7 +717,9 @@ void Search::SaveViewProperties() {
 void Search::RestoreViewProperties() {
 
     m_view.blockSignals(true);
-    if (m_filtered || (m_current_mode == Search::ViewMode::ByItem)) {
+    if (m_current_mode == Search::ViewMode::ByItem) {
+        // The flat table has nothing to expand.
+    } else if (m_filtered) {
         m_view.expandToDepth(0);
     } else {
         const int row_count = m_model.rowCount();
@@ -19,26 +19,72 @@
 
 #pragma once
 
+#include <QModelIndex>
 #include <QString>
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <utility>
 
 #include "util/util.h"
 
 #include "item.h"
 #include "items_model.h"
+#include "items_table_model.h"
 #include "column.h"
 #include "bucket.h"
+#include "itemindex.h"
+#include "filters.h"
 
 class BuyoutManager;
-class Filter;
-class FilterData;
 class ItemsModel;
+class QAbstractItemModel;
 class QTreeView;
 class QModelIndex;
 
+// The part of a search that finds the matching items. It works on copies of
+// the filter data, so it can run on another thread while the search form
+// changes, and it stops early when it's cancelled. The items and the index
+// must not change while it runs.
+class SearchJob {
+public:
+    SearchJob(const Items& items, const ItemIndex& index);
+    void Run();
+    void Cancel() { m_cancelled = true; };
+    bool cancelled() const { return m_cancelled; };
+private:
+    friend class Search;
+
+    struct FilterRun {
+        FilterData data;
+        double rank;
+        size_t evaluated;
+        size_t passed;
+        qint64 elapsed;
+    };
+
+    void CheckItems(FilterRun& run, std::vector<size_t>& candidates) const;
+
+    const Items& m_items;
+    const ItemIndex& m_index;
+    bool m_use_index;
+    bool m_incremental;
+    ItemBitmap m_previous_matches;
+
+    // Active filters that only look at the items, and those that read data
+    // owned by the GUI thread, which are checked when the job is finished.
+    std::vector<FilterRun> m_filters;
+    std::vector<FilterRun> m_local_filters;
+
+    std::atomic<bool> m_cancelled;
+
+    // The sorted positions of the matching items.
+    std::vector<size_t> m_matches;
+};
+
 class Search {
 public:
     enum class ViewMode : int {
@@ -49,18 +95,25 @@ public:
         const QString& caption,
         const std::vector<std::unique_ptr<Filter>>& filters,
         QTreeView* view);
-    void FilterItems(const Items& items);
+    void FilterItems(const Items& items, const ItemIndex& index);
+    // FilterItems() in two steps, so that the job can be run on another thread.
+    std::shared_ptr<SearchJob> CreateJob(const Items& items, const ItemIndex& index);
+    void FinishJob(SearchJob& job);
     void FromForm();
     void ToForm();
     void ResetForm();
     const QString& caption() const { return m_caption; }
     const Items& items() const { return m_items; }
     const std::vector<std::unique_ptr<Column>>& columns() const { return m_columns; }
+    // What a column shows for an item in the given role.
+    QVariant CellData(const Item& item, int column, int role) const;
     const std::vector<Bucket>& buckets() const;
     void RenameCaption(const QString& newName);
     QString GetCaption() const;
     // Sets this search as current, will display items in passed QTreeView.
-    void Activate(const Items& items);
+    void Activate(const Items& items, const ItemIndex& index);
+    // Displays the current results in the view.
+    void ShowResults();
     void RestoreViewProperties();
     void SaveViewProperties();
     ItemLocation GetTabLocation(const QModelIndex& index) const;
@@ -68,19 +121,31 @@ public:
     ViewMode GetViewMode() const { return m_current_mode; }
     bool has_bucket(int row) const;
     const Bucket& bucket(int row) const;
+    // All matching items, in the order shown by the "By Item" view.
+    const Bucket& item_bucket() const { return m_bucket_by_item.front(); }
+    QAbstractItemModel* model();
     const QModelIndex index(const std::shared_ptr<Item>& item) const;
+    // Returns the item shown at an index, or nullptr for a tab row.
+    std::shared_ptr<Item> item(const QModelIndex& index) const;
+    // Repaint rows after the values shown for their items have changed.
+    void ItemsChanged(const QModelIndexList& indices);
     void SetRefreshReason(RefreshReason::Type reason) { m_refresh_reason = reason; }
     void Sort(int column, Qt::SortOrder order);
 private:
     std::vector<Bucket>& active_buckets();
+    void SetViewModel();
+    void UpdateItemRows() const;
+    void UpdateBuckets(const Items& items, const std::vector<size_t>& matches, const ItemIndex& index, bool use_index, bool incremental);
 
     BuyoutManager& m_bo_manager;
     QTreeView& m_view;
 
     std::vector<std::unique_ptr<FilterData>> m_filters;
     std::vector<std::unique_ptr<Column>> m_columns;
+    mutable ColumnCache m_column_cache;
 
     ItemsModel m_model;
+    ItemsTableModel m_table_model;
     std::vector<Bucket> m_bucket_by_tab;
     std::vector<Bucket> m_bucket_by_item;
 
@@ -91,4 +156,15 @@ private:
     std::set<QString> m_expanded_property;
     ViewMode m_current_mode;
     RefreshReason::Type m_refresh_reason;
+
+    // The (bucket row, item row) of each item in the "By Tab" view, used to
+    // find the index of the selected item. It's rebuilt when it's needed
+    // after the buckets have been filtered or sorted.
+    mutable std::unordered_map<const Item*, std::pair<int, int>> m_item_rows;
+    mutable bool m_item_rows_valid;
+
+    // The matching item positions from the last time items were filtered,
+    // and the index generation they belong to.
+    ItemBitmap m_matches;
+    quint64 m_generation;
 };
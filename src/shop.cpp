@@ -383,6 +383,9 @@ void Shop::SubmitSingleShop() {
         request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
         request.setRawHeader("Cache-Control", "max-age=0");
         request.setTransferTimeout(kEditThreadTimeout);
+        // The CSRF token changes, so it must not come from the disk cache.
+        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+        request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
         QNetworkReply* fetched = m_network_manager.get(request);
         connect(fetched, &QNetworkReply::finished, this, &Shop::OnEditPageFinished);
     };
@@ -19,8 +19,10 @@
 
 #include "itemtooltip.h"
 
+#include <QCache>
 #include <QImage>
 #include <QPainter>
+#include <QPixmapCache>
 #include <QString>
 
 #include <QsLog/QsLog.h>
@@ -45,6 +47,9 @@ constexpr QSize HEADER_SINGLELINE_SIZE(HEADER_SINGLELINE_WIDTH, HEADER_SINGLELIN
 constexpr QSize HEADER_DOUBLELINE_SIZE(HEADER_DOUBLELINE_WIDTH, HEADER_DOUBLELINE_HEIGHT);
 constexpr QSize HEADER_OVERLAY_SIZE(27, 27);
 
+// Tooltip text is cached for the most recently selected items.
+constexpr int MAX_CACHED_TOOLTIPS = 256;
+
 class IMAGES {
 private:
     IMAGES() = default;
@@ -227,6 +232,29 @@ static QString GenerateItemInfo(const Item& item, const QString& key, bool fancy
     return "<center>" + text + "</center>";
 }
 
+struct TooltipText {
+    QString properties;
+    QString text;
+};
+
+// Items with the same hash can still show different text, so the cache is
+// keyed by the item itself, and cleared when the items are replaced.
+static QCache<const Item*, TooltipText> tooltip_cache(MAX_CACHED_TOOLTIPS);
+
+static TooltipText GetTooltipText(const Item& item, const QString& key) {
+    const TooltipText* cached = tooltip_cache.object(&item);
+    if (cached) {
+        return *cached;
+    };
+    const TooltipText text{ GenerateItemInfo(item, key, true), GenerateItemInfo(item, key, false) };
+    tooltip_cache.insert(&item, new TooltipText(text));
+    return text;
+}
+
+void ClearItemTooltipCache() {
+    tooltip_cache.clear();
+}
+
 static std::array FrameToKey = {
     "White",
     "Magic",
@@ -260,7 +288,7 @@ static void UpdateMinimap(const Item& item, Ui::MainWindow* ui) {
     ui->minimapLabel->setPixmap(pixmap);
 }
 
-void GenerateItemHeaderSide(QLabel* itemHeader, bool leftNotRight, QString header_path_prefix, bool singleline, Item::INFLUENCE_TYPES base) {
+static QPixmap RenderItemHeaderSide(bool leftNotRight, const QString& header_path_prefix, bool singleline, Item::INFLUENCE_TYPES base) {
     QImage header(header_path_prefix + (leftNotRight ? "Left.png" : "Right.png"));
     QSize header_size = singleline ? HEADER_SINGLELINE_SIZE : HEADER_DOUBLELINE_SIZE;
     header = header.scaled(header_size);
@@ -315,19 +343,41 @@ void GenerateItemHeaderSide(QLabel* itemHeader, bool leftNotRight, QString heade
         int overlay_y = (int)(0.5 * (header.height() - overlay_image.height()));
         header_painter.drawImage(overlay_x, overlay_y, overlay_image);
     }
+    return header_pixmap;
+}
 
-    itemHeader->setFixedSize(header_size);
+void GenerateItemHeaderSide(QLabel* itemHeader, bool leftNotRight, QString header_path_prefix, bool singleline, Item::INFLUENCE_TYPES base) {
+    // There are only a few combinations of frame, influence and size, so
+    // each header is only drawn once.
+    const QString key = header_path_prefix
+        + (leftNotRight ? "Left" : "Right")
+        + (singleline ? "SingleLine" : "DoubleLine")
+        + QString::number(base);
+    QPixmap header_pixmap;
+    if (!QPixmapCache::find(key, &header_pixmap)) {
+        header_pixmap = RenderItemHeaderSide(leftNotRight, header_path_prefix, singleline, base);
+        QPixmapCache::insert(key, header_pixmap);
+    };
+    itemHeader->setFixedSize(singleline ? HEADER_SINGLELINE_SIZE : HEADER_DOUBLELINE_SIZE);
     itemHeader->setPixmap(header_pixmap);
 }
 
+static void SetStyleSheet(QWidget* widget, const QString& css) {
+    // Setting a style sheet restyles the widget even when nothing changed.
+    if (widget->styleSheet() != css) {
+        widget->setStyleSheet(css);
+    };
+}
+
 void UpdateItemTooltip(const Item& item, Ui::MainWindow* ui) {
     size_t frame = item.frameType();
     if (frame >= FrameToKey.size())
         frame = 0;
     QString key = FrameToKey[frame];
 
-    ui->propertiesLabel->setText(GenerateItemInfo(item, key, true));
-    ui->itemTextTooltip->setText(GenerateItemInfo(item, key, false));
+    const TooltipText text = GetTooltipText(item, key);
+    ui->propertiesLabel->setText(text.properties);
+    ui->itemTextTooltip->setText(text.text);
     UpdateMinimap(item, ui);
 
     bool singleline = item.name().isEmpty();
@@ -347,15 +397,15 @@ void UpdateItemTooltip(const Item& item, Ui::MainWindow* ui) {
     GenerateItemHeaderSide(ui->itemHeaderLeft, true, header_path_prefix, singleline, item.influenceLeft());
     GenerateItemHeaderSide(ui->itemHeaderRight, false, header_path_prefix, singleline, item.influenceRight());
 
-    ui->itemNameContainerWidget->setStyleSheet(("border-radius: 0px; border: 0px; border-image: url(" + header_path_prefix + "Middle.png);"));
+    SetStyleSheet(ui->itemNameContainerWidget, "border-radius: 0px; border: 0px; border-image: url(" + header_path_prefix + "Middle.png);");
 
     ui->itemNameFirstLine->setText(item.name());
     ui->itemNameSecondLine->setText(item.typeLine());
 
     const QString color = FrameToColor[frame];
     const QString css = "border-image: none; background-color: transparent; font-size: 20px; color: " + color;
-    ui->itemNameFirstLine->setStyleSheet(css);
-    ui->itemNameSecondLine->setStyleSheet(css);
+    SetStyleSheet(ui->itemNameFirstLine, css);
+    SetStyleSheet(ui->itemNameSecondLine, css);
 }
 
 QPixmap GenerateItemSockets(const int width, const int height, const std::vector<ItemSocket>& sockets) {
@@ -24,4 +24,6 @@
 #include "item.h"
 
 void UpdateItemTooltip(const Item& item, Ui::MainWindow* ui);
+// Forget the tooltips of items that may no longer exist.
+void ClearItemTooltipCache();
 QPixmap GenerateItemIcon(const Item& item, const QImage& image);
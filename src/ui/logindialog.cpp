@@ -385,6 +385,9 @@ void LoginDialog::LoginWithSessionID() {
     QLOG_INFO() << "Starting legacy login with POESESSID";
     QNetworkRequest request = QNetworkRequest(QUrl(POE_LOGIN_CHECK_URL));
     request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
+    // The result depends on the session, so it must not come from the disk cache.
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
     QNetworkReply* reply = m_network_manager.get(request);
 
     connect(reply, &QNetworkReply::finished, this, &LoginDialog::OnStartLegacyLogin);
@@ -448,6 +451,8 @@ void LoginDialog::OnStartLegacyLogin() {
     // we need one more request to get account name
     QNetworkRequest request = QNetworkRequest(QUrl(POE_MY_ACCOUNT));
     request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
     QNetworkReply* next_reply = m_network_manager.get(request);
 
     connect(next_reply, &QNetworkReply::finished, this, &LoginDialog::OnFinishLegacyLogin);
@@ -36,6 +36,7 @@
 #include <QNetworkReply>
 #include <QPainter>
 #include <QPushButton>
+#include <QSet>
 #include <QScrollArea>
 #include <QString>
 #include <QStringList>
@@ -51,6 +52,7 @@
 #include "ratelimit/ratelimit.h"
 #include "ratelimit/ratelimitdialog.h"
 #include "ratelimit/ratelimiter.h"
+#include "util/networkmanager.h"
 #include "util/oauthmanager.h"
 #include "util/updatechecker.h"
 #include "util/util.h"
@@ -127,11 +129,16 @@ MainWindow::MainWindow(
     m_delayed_search_form_change.setSingleShot(true);
     connect(&m_delayed_search_form_change, &QTimer::timeout, this, &MainWindow::OnSearchFormChange);
 
+    m_search_pool.setMaxThreadCount(1);
+
     LoadSettings();
     NewSearch();
 }
 
 MainWindow::~MainWindow() {
+    // Search jobs post their results back to this window.
+    CancelSearch();
+    m_search_pool.waitForDone();
     delete ui;
     for (auto& search : m_searches) {
         delete(search);
@@ -216,11 +223,9 @@ void MainWindow::InitializeUi() {
         [&](int n) {
             const auto mode = static_cast<Search::ViewMode>(n);
             m_current_search->SetViewMode(mode);
-            if (mode == Search::ViewMode::ByItem) {
-                OnExpandAll();
-            } else {
-                ResizeTreeColumns();
-            };
+            // Each view mode has its own model.
+            ConnectViewSignals();
+            ResizeTreeColumns();
         });
 
     ui->buyoutTypeComboBox->setEnabled(false);
@@ -348,6 +353,17 @@ void MainWindow::InitializeUi() {
     // Connect the POESESSID submenu
     connect(ui->actionShowPOESESSID, &QAction::triggered, this, &MainWindow::OnShowPOESESSID);
 
+    // Connect the image download setting
+    connect(ui->actionDownloadItemImages, &QAction::triggered, this, &MainWindow::OnSetDownloadItemImages);
+
+    // Connect the network statistics, which are only kept by our own network manager.
+    auto* network_manager = qobject_cast<NetworkManager*>(&m_network_manager);
+    if (network_manager) {
+        connect(ui->actionShowNetworkStatistics, &QAction::triggered, network_manager, &NetworkManager::ShowStatistics);
+    } else {
+        ui->actionShowNetworkStatistics->setEnabled(false);
+    };
+
     // Connect the Tooltip tab buttons
     connect(ui->uploadTooltipButton, &QPushButton::clicked, this, &MainWindow::OnUploadToImgur);
     connect(ui->pobTooltipButton, &QPushButton::clicked, this, &MainWindow::OnCopyForPOB);
@@ -362,6 +378,7 @@ void MainWindow::LoadSettings() {
     ui->actionSetDefaultTheme->setChecked(theme == "default");
 
     ui->actionSetAutomaticTabRefresh->setChecked(m_settings.value("autoupdate").toBool());
+    ui->actionDownloadItemImages->setChecked(m_settings.value("download_item_images").toBool());
     UpdateShopMenu();
 
     ui->itemInfoTypeTabs->setCurrentIndex(m_settings.value("tooltip_tab").toInt());
@@ -472,6 +489,7 @@ void MainWindow::OnBuyoutChange() {
         return;
     };
 
+    QModelIndexList changed;
     for (auto const& index : ui->treeView->selectionModel()->selectedRows()) {
         auto const& tab = m_current_search->GetTabLocation(index).GetUniqueHash();
 
@@ -480,29 +498,22 @@ void MainWindow::OnBuyoutChange() {
             QLOG_TRACE() << "MainWindow::OnBuyoutChange() refusing to update locked tab:" << tab;
             continue;
         };
-        if (!index.parent().isValid()) {
-            m_buyout_manager.SetTab(tab, bo);
+        const auto item = m_current_search->item(index);
+        if (!item) {
+            if ((m_current_search->GetViewMode() == Search::ViewMode::ByTab) && !index.parent().isValid()) {
+                m_buyout_manager.SetTab(tab, bo);
+            };
         } else {
-            const int bucket_row = index.parent().row();
-            if (m_current_search->has_bucket(bucket_row)) {
-                const Bucket& bucket = m_current_search->bucket(bucket_row);
-                const int item_row = index.row();
-                if (bucket.has_item(item_row)) {
-                    const Item& item = *bucket.item(item_row);
-                    // Don't allow users to manually update locked items (game priced per item in note section)
-                    if (m_buyout_manager.Get(item).IsGameSet()) {
-                        QLOG_TRACE() << "MainWindow::OnBuyoutChange() refusing to update locked item:" << item.name();
-                        continue;
-                    };
-                    m_buyout_manager.Set(item, bo);
-                } else {
-                    QLOG_ERROR() << "OnBuyoutChange(): bucket" << bucket_row << "does not have" << item_row << "items";
-                };
-            } else {
-                QLOG_ERROR() << "OnBuyoutChange(): bucket" << bucket_row << "does not exist";
+            // Don't allow users to manually update locked items (game priced per item in note section)
+            if (m_buyout_manager.Get(*item).IsGameSet()) {
+                QLOG_TRACE() << "MainWindow::OnBuyoutChange() refusing to update locked item:" << item->name();
+                continue;
             };
+            m_buyout_manager.Set(*item, bo);
+            changed.append(index);
         };
     };
+    m_current_search->ItemsChanged(changed);
     m_items_manager.PropagateTabBuyouts();
     ResizeTreeColumns();
 }
@@ -578,28 +589,68 @@ void MainWindow::OnSearchFormChange() {
     QLOG_TRACE() << "MainWindow::OnSearchFormChange() entered";
     m_current_search->SaveViewProperties();
     m_current_search->SetRefreshReason(RefreshReason::SearchFormChanged);
-    ModelViewRefresh();
+    m_buyout_manager.Save();
+
+    // Search in the background so that a slow search doesn't hold up typing.
+    // A search that hasn't finished yet is replaced by the new one, and the
+    // view keeps showing the old results until the new ones are ready.
+    CancelSearch();
+    m_current_search->FromForm();
+    const auto job = m_current_search->CreateJob(m_items_manager.items(), m_items_manager.index());
+    m_search_job = job;
+    m_search_pool.start([this, job]() {
+        job->Run();
+        QMetaObject::invokeMethod(this, [this, job]() { OnSearchFinished(job); }, Qt::QueuedConnection);
+        });
+}
+
+void MainWindow::OnSearchFinished(const std::shared_ptr<SearchJob>& job) {
+    if ((job != m_search_job) || job->cancelled()) {
+        QLOG_TRACE() << "MainWindow::OnSearchFinished() ignoring a cancelled search";
+        return;
+    };
+    m_search_job = nullptr;
+    m_current_search->FinishJob(*job);
+    m_current_search->ShowResults();
+    UpdateSearchView();
+}
+
+void MainWindow::CancelSearch() {
+    if (m_search_job) {
+        m_search_job->Cancel();
+        m_search_job = nullptr;
+    };
 }
 
 void MainWindow::ModelViewRefresh() {
     QLOG_TRACE() << "MainWindow::ModelViewRefresh() entered";
     m_buyout_manager.Save();
 
-    QLOG_TRACE() << "MainWindow::ModelViewRefresh() activing current search";
-    m_current_search->Activate(m_items_manager.items());
-    ResizeTreeColumns();
+    // Results from a background search would be out of date.
+    CancelSearch();
 
-    // This updates the item information when current item changes.
-    connect(ui->treeView->selectionModel(), &QItemSelectionModel::currentChanged, this, &MainWindow::OnCurrentItemChanged);
+    QLOG_TRACE() << "MainWindow::ModelViewRefresh() activing current search";
+    m_current_search->Activate(m_items_manager.items(), m_items_manager.index());
+    UpdateSearchView();
+}
 
-    // This updates the item information when a search or sort order changes.
-    connect(ui->treeView->model(), &QAbstractItemModel::layoutChanged, this, &MainWindow::OnLayoutChanged);
+void MainWindow::UpdateSearchView() {
+    ResizeTreeColumns();
+    ConnectViewSignals();
 
     ui->viewComboBox->setCurrentIndex(static_cast<int>(m_current_search->GetViewMode()));
 
     m_tab_bar->setTabText(m_tab_bar->currentIndex(), m_current_search->GetCaption());
 }
 
+void MainWindow::ConnectViewSignals() {
+    // This updates the item information when current item changes.
+    connect(ui->treeView->selectionModel(), &QItemSelectionModel::currentChanged, this, &MainWindow::OnCurrentItemChanged, Qt::UniqueConnection);
+
+    // This updates the item information when a search or sort order changes.
+    connect(ui->treeView->model(), &QAbstractItemModel::layoutChanged, this, &MainWindow::OnLayoutChanged, Qt::UniqueConnection);
+}
+
 void MainWindow::OnCurrentItemChanged(const QModelIndex& current, const QModelIndex& previous) {
     Q_UNUSED(previous);
     QLOG_TRACE() << "MainWindow::OnCurrentItemChange() entered";
@@ -609,22 +660,12 @@ void MainWindow::OnCurrentItemChanged(const QModelIndex& current, const QModelIn
         return;
     };
 
-    if (current.parent().isValid()) {
+    const auto item = m_current_search->item(current);
+    if (item) {
         // Clicked on an item
-        const int bucket_row = current.parent().row();
-        if (m_current_search->has_bucket(bucket_row)) {
-            const Bucket& bucket = m_current_search->bucket(bucket_row);
-            const int item_row = current.row();
-            if (bucket.has_item(item_row)) {
-                m_current_item = bucket.item(item_row);
-                m_delayed_update_current_item.start();
-            } else {
-                QLOG_WARN() << "OnCurrentItemChanged(): parent bucket" << bucket_row << "does not have" << item_row << "rows";
-            };
-        } else {
-            QLOG_WARN() << "OnCurrentItemChanged(): parent bucket" << bucket_row << "does not exist";
-        };
-    } else {
+        m_current_item = item;
+        m_delayed_update_current_item.start();
+    } else if ((m_current_search->GetViewMode() == Search::ViewMode::ByTab) && !current.parent().isValid()) {
         // Clicked on a bucket
         m_current_item = nullptr;
         const int bucket_row = current.row();
@@ -852,16 +893,43 @@ void MainWindow::UpdateCurrentItem() {
     ui->locationLabel->setText(m_current_item->location().GetHeader());
     ui->pobTooltipButton->setEnabled(m_current_item->Wearable());
 
-    QString icon = m_current_item->icon();
+    emit GetImage(GetIconUrl(*m_current_item));
+    PrefetchNeighbourIcons();
+}
+
+void MainWindow::PrefetchNeighbourIcons() {
+    // Load the icons of the items around the current one, so paging
+    // through items with the arrow keys doesn't wait for images.
+    constexpr int PREFETCH_ROWS = 2;
+    const QModelIndex current = ui->treeView->currentIndex();
+    if (!m_current_search->item(current)) {
+        return;
+    };
+    QStringList urls;
+    for (int offset = 1; offset <= PREFETCH_ROWS; ++offset) {
+        for (const int row : { current.row() + offset, current.row() - offset }) {
+            const auto item = m_current_search->item(current.siblingAtRow(row));
+            if (item) {
+                urls.append(GetIconUrl(*item));
+            };
+        };
+    };
+    if (!urls.isEmpty()) {
+        emit PrefetchImages(urls);
+    };
+}
+
+QString MainWindow::GetIconUrl(const Item& item) {
+    QString icon = item.icon();
     if ((icon.size() >= 1) && (icon[0] == '/')) {
         icon = POE_WEBCDN + icon;
     };
-    emit GetImage(icon);
+    return icon;
 }
 
 void MainWindow::OnImageFetched(const QString& url) {
     if (m_current_item) {
-        const QString icon = m_current_item->icon();
+        const QString icon = GetIconUrl(*m_current_item);
         if (url == icon) {
             const QImage image = m_image_cache.load(url);
             if (!image.isNull()) {
@@ -902,19 +970,50 @@ void MainWindow::UpdateCurrentBuyout() {
     };
 }
 
+void MainWindow::OnItemsAboutToRefresh() {
+    // A background search reads the items and the index, so it has to stop
+    // before they change. The search will be run again after the refresh.
+    CancelSearch();
+    m_search_pool.waitForDone();
+}
+
 void MainWindow::OnItemsRefreshed() {
     QLOG_TRACE() << "MainWindow::OnItemsRefreshed() entered";
+    ClearItemTooltipCache();
     int tab = 0;
     for (auto search : m_searches) {
         search->SetRefreshReason(RefreshReason::ItemsChanged);
         // Don't update current search - it will be updated in OnSearchFormChange
         if (search != m_current_search) {
-            search->FilterItems(m_items_manager.items());
+            search->FilterItems(m_items_manager.items(), m_items_manager.index());
             m_tab_bar->setTabText(tab, search->GetCaption());
         };
         tab++;
     };
+    // If the search form was edited and the delayed update hasn't happened
+    // yet, the current search can't reuse its previous results.
+    if (m_delayed_search_form_change.isActive()) {
+        m_delayed_search_form_change.stop();
+        m_current_search->SaveViewProperties();
+        m_current_search->SetRefreshReason(RefreshReason::SearchFormChanged);
+    };
     ModelViewRefresh();
+    if (ui->actionDownloadItemImages->isChecked()) {
+        DownloadItemImages();
+    };
+}
+
+void MainWindow::DownloadItemImages() {
+    QSet<QString> unique;
+    QStringList urls;
+    for (const auto& item : m_items_manager.items()) {
+        const QString url = GetIconUrl(*item);
+        if (!unique.contains(url)) {
+            unique.insert(url);
+            urls.append(url);
+        };
+    };
+    emit WarmUpImages(urls);
 }
 
 void MainWindow::OnSetShopThreads() {
@@ -999,6 +1098,14 @@ void MainWindow::OnSetAutomaticTabRefresh() {
     m_items_manager.SetAutoUpdate(ui->actionSetAutomaticTabRefresh->isChecked());
 }
 
+void MainWindow::OnSetDownloadItemImages() {
+    const bool enabled = ui->actionDownloadItemImages->isChecked();
+    m_settings.setValue("download_item_images", enabled);
+    if (enabled) {
+        DownloadItemImages();
+    };
+}
+
 void MainWindow::OnUpdateStashIndex() {
     m_shop.UpdateStashIndex();
 }
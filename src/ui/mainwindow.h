@@ -24,7 +24,9 @@
 #include <QMainWindow>
 #include <QMenu>
 #include <QPushButton>
+#include <QStringList>
 #include <QCloseEvent>
+#include <QThreadPool>
 #include <QTimer>
 
 #include <QsLog/QsLogLevel.h>
@@ -49,6 +51,7 @@ class OAuthManager;
 class RateLimiter;
 class RateLimitDialog;
 class Search;
+class SearchJob;
 class Shop;
 class UpdateChecker;
 
@@ -92,6 +95,8 @@ signals:
     void SetSessionId(const QString& poesessid);
     void SetTheme(const QString& theme);
     void GetImage(const QString& url);
+    void PrefetchImages(const QStringList& urls);
+    void WarmUpImages(const QStringList& urls);
 public slots:
     void OnCurrentItemChanged(const QModelIndex& current, const QModelIndex& previous);
     void OnLayoutChanged();
@@ -99,6 +104,7 @@ public slots:
     void OnDelayedSearchFormChange();
     void OnTabChange(int index);
     void OnImageFetched(const QString& url);
+    void OnItemsAboutToRefresh();
     void OnItemsRefreshed();
     void OnStatusUpdate(ProgramState state, const QString& status);
     void OnBuyoutChange();
@@ -130,6 +136,7 @@ private slots:
     void OnUpdateShops();
     void OnSetAutomaticShopUpdate();
     void OnShowPOESESSID();
+    void OnSetDownloadItemImages();
 
     // Theme submenu actions
     void OnSetDarkTheme(bool toggle);
@@ -145,9 +152,16 @@ private slots:
 
 private:
     void ModelViewRefresh();
+    void UpdateSearchView();
+    void ConnectViewSignals();
+    void CancelSearch();
+    void OnSearchFinished(const std::shared_ptr<SearchJob>& job);
     void ClearCurrentItem();
     void UpdateCurrentBucket();
     void UpdateCurrentItem();
+    void PrefetchNeighbourIcons();
+    static QString GetIconUrl(const Item& item);
+    void DownloadItemImages();
     void UpdateCurrentBuyout();
     void NewSearch();
     void InitializeRateLimitDialog();
@@ -187,6 +201,10 @@ private:
     QPushButton m_refresh_button;
     QTimer m_delayed_update_current_item;
     QTimer m_delayed_search_form_change;
+
+    // Searches started from the search form run here, one at a time.
+    QThreadPool m_search_pool;
+    std::shared_ptr<SearchJob> m_search_job;
     RateLimitDialog* m_rate_limit_dialog;
     bool m_quitting;
 };
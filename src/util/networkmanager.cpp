@@ -19,63 +19,161 @@
 
 #include "networkmanager.h"
 
-#include <QNetworkAccessManager>
+#include <QMessageBox>
+#include <QNetworkDiskCache>
+#include <QNetworkInformation>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 
+#include <algorithm>
+#include <memory>
+
 #include <QsLog/QsLog.h>
 
 #include "network_info.h"
 
-NetworkManager::NetworkManager()
-{
-    m_network_manager = std::make_unique<QNetworkAccessManager>();
-
-    m_network_info = QNetworkInformation::instance();
-
-    connect(m_network_info, &QNetworkInformation::reachabilityChanged, this,
-        [=](QNetworkInformation::Reachability reachability) {
-            QLOG_INFO() << "NetworkManager: reachability changed to" << reachability;
-            m_offline = (reachability != QNetworkInformation::Reachability::Online);
-        });
-}
+// Keep idle connections open long enough to be reused between rate-limited
+// requests, which can be spaced out by up to a minute or more.
+constexpr int CONNECTION_EXPIRY_SECONDS = 300;
 
-NetworkManager::~NetworkManager() {};
+// Maximum size of the disk cache.
+constexpr qint64 DISK_CACHE_BYTES = 256 * 1024 * 1024;
 
-QNetworkReply* NetworkManager::get(const QNetworkRequest& request) {
-    return m_offline ? nullptr : m_network_manager->get(prepare(request));
+NetworkManager::NetworkManager()
+    : QNetworkAccessManager()
+{
+    if (QNetworkInformation::loadDefaultBackend()) {
+        connect(QNetworkInformation::instance(), &QNetworkInformation::reachabilityChanged, this,
+            [](QNetworkInformation::Reachability reachability) {
+                QLOG_INFO() << "NetworkManager: reachability changed to" << reachability;
+            });
+    } else {
+        QLOG_DEBUG() << "NetworkManager: network information is not available";
+    };
 }
 
-QNetworkReply* NetworkManager::get(const QNetworkRequest& request, QIODevice* data) {
-    return m_offline ? nullptr : m_network_manager->get(prepare(request), data);
+NetworkManager::~NetworkManager() {
+    LogStatistics();
 }
 
-QNetworkReply* NetworkManager::get(const QNetworkRequest& request, const QByteArray& data) {
-    return m_offline ? nullptr : m_network_manager->get(prepare(request), data);
+void NetworkManager::SetCacheDirectory(const QString& directory) {
+    QLOG_DEBUG() << "NetworkManager: using disk cache in" << directory;
+    auto* cache = new QNetworkDiskCache(this);
+    cache->setCacheDirectory(directory);
+    cache->setMaximumCacheSize(DISK_CACHE_BYTES);
+    setCache(cache);
 }
 
-QNetworkReply* NetworkManager::head(const QNetworkRequest& request) {
-    return m_offline ? nullptr : m_network_manager->head(prepare(request));
-}
+QNetworkReply* NetworkManager::createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoing_data) {
 
-QNetworkReply* NetworkManager::post(const QNetworkRequest& request, QIODevice* data) {
-    return m_offline ? nullptr : m_network_manager->post(prepare(request), data);
+    QNetworkRequest outgoing_request(request);
+    if (!outgoing_request.hasRawHeader("User-Agent")) {
+        outgoing_request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
+    };
+    outgoing_request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    outgoing_request.setAttribute(QNetworkRequest::ConnectionCacheExpiryTimeoutSecondsAttribute, CONNECTION_EXPIRY_SECONDS);
+
+    // Qt only decompresses replies automatically when the Accept-Encoding
+    // header is left for it to fill in, so it's never set here.
+    if (outgoing_request.hasRawHeader("Accept-Encoding")) {
+        QLOG_DEBUG() << "NetworkManager: request for" << request.url().toString()
+            << "sets Accept-Encoding, so the reply will not be decompressed";
+    };
+
+    const QString host = request.url().host();
+    HostStatistics& stats = m_statistics[host];
+    ++stats.requests;
+    ++stats.in_flight;
+    stats.max_in_flight = std::max(stats.max_in_flight, stats.in_flight);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QNetworkReply* reply = QNetworkAccessManager::createRequest(op, outgoing_request, outgoing_data);
+
+    // This is only emitted when a new connection has to be made.
+    connect(reply, &QNetworkReply::socketStartedConnecting, this,
+        [this, host]() { ++m_statistics[host].connections; });
+
+    // The progress is reported in bytes received before decompression, which
+    // is the only way to know the size of replies sent without a length.
+    auto bytes_received = std::make_shared<qint64>(0);
+    connect(reply, &QNetworkReply::downloadProgress, this,
+        [bytes_received](qint64 received, qint64 /* total */) { *bytes_received = received; });
+
+    // This is connected before the caller can connect to the reply, so the
+    // whole body is still available to be counted.
+    connect(reply, &QNetworkReply::finished, this,
+        [this, reply, host, timer, bytes_received]() { OnReplyFinished(reply, host, timer, *bytes_received); });
+
+    return reply;
 }
 
-QNetworkReply* NetworkManager::post(const QNetworkRequest& request, QHttpMultiPart* multiPart) {
-    return m_offline ? nullptr : m_network_manager->post(prepare(request), multiPart);
+void NetworkManager::OnReplyFinished(QNetworkReply* reply, const QString& host, const QElapsedTimer& timer, qint64 bytes_received) {
+
+    HostStatistics& stats = m_statistics[host];
+    --stats.in_flight;
+
+    const qint64 latency = timer.elapsed();
+    stats.total_latency_msec += latency;
+    stats.max_latency_msec = std::max(stats.max_latency_msec, latency);
+
+    if (reply->error() != QNetworkReply::NoError) {
+        ++stats.errors;
+    };
+    if (reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool()) {
+        ++stats.http2_requests;
+    };
+    const bool from_cache = reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
+    if (from_cache) {
+        ++stats.cached_requests;
+    };
+
+    if (reply->operation() == QNetworkAccessManager::HeadOperation) {
+        return;
+    };
+
+    // Nothing was received over the network for a reply from the cache.
+    stats.decompressed_bytes += reply->bytesAvailable();
+    if (!from_cache) {
+        stats.compressed_bytes += bytes_received;
+    };
 }
 
-QNetworkReply* NetworkManager::post(const QNetworkRequest& request, const QByteArray& data) {
-    return m_offline ? nullptr : m_network_manager->post(prepare(request), data);
+QStringList NetworkManager::StatisticsText() const {
+    QStringList lines;
+    for (const auto& [host, stats] : m_statistics) {
+        const qint64 average_latency = (stats.requests > 0) ? (stats.total_latency_msec / stats.requests) : 0;
+        lines.append(QString("%1: %2 requests, %3 connections, %4 over HTTP/2, %5 from cache, %6 errors, "
+            "max %7 in flight, %8 bytes received, %9 bytes decompressed, latency %10 msec average, %11 msec max").arg(
+                host,
+                QString::number(stats.requests),
+                QString::number(stats.connections),
+                QString::number(stats.http2_requests),
+                QString::number(stats.cached_requests),
+                QString::number(stats.errors),
+                QString::number(stats.max_in_flight),
+                QString::number(stats.compressed_bytes),
+                QString::number(stats.decompressed_bytes),
+                QString::number(average_latency),
+                QString::number(stats.max_latency_msec)));
+    };
+    return lines;
 }
 
-QNetworkReply* NetworkManager::post(const QNetworkRequest& request, std::nullptr_t nptr) {
-    return m_offline ? nullptr : m_network_manager->post(prepare(request), nptr);
+void NetworkManager::LogStatistics() const {
+    for (const auto& line : StatisticsText()) {
+        QLOG_INFO() << "NetworkManager:" << line;
+    };
 }
 
-QNetworkRequest NetworkManager::prepare(const QNetworkRequest& request) {
-    QNetworkRequest outgoing_request(request);
-    outgoing_request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
-    return outgoing_request;
+void NetworkManager::ShowStatistics() {
+    QMessageBox* msgBox = new QMessageBox;
+    msgBox->setWindowTitle("Network Statistics - " APP_NAME);
+    msgBox->setModal(false);
+    msgBox->setAttribute(Qt::WA_DeleteOnClose);
+    const QStringList lines = StatisticsText();
+    msgBox->setText(lines.isEmpty() ? "No requests have been made yet." : lines.join("\n\n"));
+    msgBox->show();
+    msgBox->raise();
 }
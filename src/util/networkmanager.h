@@ -19,34 +19,76 @@
 
 #pragma once
 
-#include <QObject>
+#include <QElapsedTimer>
 #include <QNetworkAccessManager>
-#include <QNetworkInformation>
+#include <QString>
+#include <QStringList>
+
+#include <map>
 
-class QNetworkAccessManager;
 class QNetworkReply;
 class QNetworkRequest;
 
-class NetworkManager : public QObject {
+// The network access manager shared by every part of acquisition.
+//
+// All requests go through createRequest(), which makes sure they use the
+// same transport policy: the acquisition user agent, HTTP/2 where the server
+// supports it, compressed transfers, and long-lived connections so that
+// rate-limited requests do not pay for a new TLS handshake each time.
+// Requests may also be answered from a disk cache once one is configured.
+//
+// Transfer statistics are kept for each host so the effect of these
+// settings can be measured.
+class NetworkManager : public QNetworkAccessManager {
     Q_OBJECT
 public:
+
+    struct HostStatistics {
+        int requests{ 0 };
+        int errors{ 0 };
+
+        // Number of new connections that were opened to the host.
+        int connections{ 0 };
+
+        // Requests that were multiplexed over HTTP/2.
+        int http2_requests{ 0 };
+
+        // Requests that were answered from the disk cache.
+        int cached_requests{ 0 };
+
+        int in_flight{ 0 };
+        int max_in_flight{ 0 };
+
+        // Bytes received on the wire, and after decompression.
+        qint64 compressed_bytes{ 0 };
+        qint64 decompressed_bytes{ 0 };
+
+        qint64 total_latency_msec{ 0 };
+        qint64 max_latency_msec{ 0 };
+    };
+
     NetworkManager();
     ~NetworkManager();
 
-    QNetworkReply* get(const QNetworkRequest& request);
-    QNetworkReply* get(const QNetworkRequest& request, QIODevice* data);
-    QNetworkReply* get(const QNetworkRequest& request, const QByteArray& data);
+    // Enable the disk cache in the given directory.
+    void SetCacheDirectory(const QString& directory);
+
+    const std::map<QString, HostStatistics>& statistics() const { return m_statistics; };
 
-    QNetworkReply* head(const QNetworkRequest& request);
+    // One line describing the statistics of each host.
+    QStringList StatisticsText() const;
 
-    QNetworkReply* post(const QNetworkRequest& request, QIODevice* data);
-    QNetworkReply* post(const QNetworkRequest& request, QHttpMultiPart* multiPart);
-    QNetworkReply* post(const QNetworkRequest& request, const QByteArray& data);
-    QNetworkReply* post(const QNetworkRequest& request, std::nullptr_t nptr);
+    void LogStatistics() const;
+
+public slots:
+    // Show the statistics in a message box.
+    void ShowStatistics();
+
+protected:
+    QNetworkReply* createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoing_data) override;
 
 private:
-    QNetworkRequest prepare(const QNetworkRequest& request);
-    std::unique_ptr<QNetworkAccessManager> m_network_manager;
-    QNetworkInformation* m_network_info;
-    bool m_offline{ true };
+    void OnReplyFinished(QNetworkReply* reply, const QString& host, const QElapsedTimer& timer, qint64 bytes_received);
+
+    std::map<QString, HostStatistics> m_statistics;
 };
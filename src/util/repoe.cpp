@@ -19,12 +19,16 @@
 
 #include "repoe.h"
 
+#include <QDataStream>
 #include <QDir>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QSaveFile>
 #include <QString>
 
+#include <future>
+
 #include <QsLog/QsLog.h>
 
 #include "ui/mainwindow.h"
@@ -45,6 +49,13 @@ constexpr std::array STAT_TRANSLATIONS = {
     "stat_translations/necropolis.json"
 };
 
+// The compiled RePoE data is cached in this file along with the RePoE version
+// it was built from. The format number must be changed whenever the layout of
+// the cache or the list of files above changes.
+constexpr const char* REPOE_CACHE_FILE = "repoe/cache.bin";
+constexpr quint32 REPOE_CACHE_MAGIC = 0x52506f45;
+constexpr quint32 REPOE_CACHE_FORMAT = 1;
+
 RePoE::RePoE(QNetworkAccessManager& network_manager)
     : m_network_manager(network_manager)
     , m_initialized(false)
@@ -70,6 +81,10 @@ void RePoE::Init(const QString& data_dir) {
     QLOG_DEBUG() << "RePoE: requesting version.txt";
     QNetworkRequest request = QNetworkRequest(QUrl(url));
     request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
+
+    // The version has to come from the server to tell whether it changed.
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
     QNetworkReply* reply = m_network_manager.get(request);
     connect(reply, &QNetworkReply::finished, this, &RePoE::OnVersionReceived);
 }
@@ -89,6 +104,7 @@ void RePoE::OnVersionReceived() {
 
     const QByteArray data = reply->readAll();
     reply->deleteLater();
+    m_version = QString::fromUtf8(data);
 
     QDir repoe_dir(m_data_dir);
     if (!repoe_dir.exists("repoe")) {
@@ -136,7 +152,7 @@ void RePoE::OnVersionReceived() {
         BeginUpdate();
     } else {
         QLOG_INFO() << "RePoE: an update is not needed";
-        FinishUpdate();
+        FinishUpdate(true);
     }
 }
 
@@ -160,7 +176,9 @@ void RePoE::RequestNextFile() {
 
     if (m_needed_files.empty()) {
 
-        FinishUpdate();
+        // The files were just downloaded, so they have to be parsed even
+        // if there is a cache for this version.
+        FinishUpdate(false);
 
     } else {
 
@@ -171,6 +189,11 @@ void RePoE::RequestNextFile() {
         const QString url = QString(REPOE_URL) + "/" + filename;
         QNetworkRequest request = QNetworkRequest(QUrl(url));
         request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
+
+        // Files are only downloaded when there's a new version, so an
+        // older cached copy must not be used. They are saved to disk anyway.
+        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+        request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
         QNetworkReply* reply = m_network_manager.get(request);
         connect(reply, &QNetworkReply::finished, this, &RePoE::OnFileReceived);
 
@@ -212,17 +235,20 @@ void RePoE::OnFileReceived() {
     RequestNextFile();
 }
 
-void RePoE::FinishUpdate() {
+void RePoE::FinishUpdate(bool use_cache) {
 
     emit StatusUpdate(ProgramState::Initializing, "RePoE updating item classes, base types, and mods");
 
-    InitItemClasses(ReadFile("item_classes.json"));
-    InitItemBaseTypes(ReadFile("base_items.json"));
-
-    InitStatTranslations();
-    for (const auto& filename : STAT_TRANSLATIONS) {
-        AddStatTranslations(ReadFile(QString(filename)));
+    if (!use_cache || !LoadCache()) {
+        ParseFiles();
+        // Don't let a failed parse hide the data until the next version.
+        if (HasItemCategories() && HasStatTranslations()) {
+            SaveCache();
+        } else {
+            QLOG_WARN() << "RePoE: not saving the cache because some of the data is missing";
+        };
     };
+    InitItemCategories();
     InitModList();
 
     QLOG_INFO() << "RePoE: update finished";
@@ -230,7 +256,95 @@ void RePoE::FinishUpdate() {
     emit finished();
 }
 
-QByteArray RePoE::ReadFile(const QString& filename) {
+void RePoE::ParseFiles() {
+
+    QLOG_DEBUG() << "RePoE: parsing files";
+
+    // Each file is read and parsed on its own thread. Item classes and base types
+    // fill separate tables, and the stat translations are parsed into lists that
+    // are merged once all of them are done.
+    auto item_classes = std::async(std::launch::async,
+        [this]() { InitItemClasses(ReadFile("item_classes.json")); });
+    auto base_items = std::async(std::launch::async,
+        [this]() { InitItemBaseTypes(ReadFile("base_items.json")); });
+
+    std::vector<std::future<std::vector<QString>>> translations;
+    translations.reserve(STAT_TRANSLATIONS.size());
+    for (const auto& filename : STAT_TRANSLATIONS) {
+        translations.push_back(std::async(std::launch::async,
+            [this, filename]() { return ParseStatTranslations(ReadFile(QString(filename))); }));
+    };
+
+    InitStatTranslations();
+    for (auto& translation : translations) {
+        AddStatTranslations(translation.get());
+    };
+    item_classes.get();
+    base_items.get();
+}
+
+bool RePoE::LoadCache() {
+
+    const QString filepath = m_data_dir + "/" + REPOE_CACHE_FILE;
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QLOG_DEBUG() << "RePoE: there is no cache to load";
+        return false;
+    };
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 format = 0;
+    QString version;
+    stream >> magic >> format >> version;
+    if ((magic != REPOE_CACHE_MAGIC) || (format != REPOE_CACHE_FORMAT)) {
+        QLOG_DEBUG() << "RePoE: ignoring cache with an unknown format";
+        return false;
+    };
+    if (m_version.isEmpty() || (version != m_version)) {
+        QLOG_DEBUG() << "RePoE: ignoring cache for a different version:" << version;
+        return false;
+    };
+
+    if (!LoadItemCategories(stream) || !LoadStatTranslations(stream)) {
+        QLOG_WARN() << "RePoE: error loading cache:" << filepath;
+        return false;
+    };
+    if (!HasItemCategories() || !HasStatTranslations()) {
+        QLOG_WARN() << "RePoE: ignoring cache with missing data:" << filepath;
+        return false;
+    };
+    QLOG_DEBUG() << "RePoE: loaded cache for version" << version;
+    return true;
+}
+
+void RePoE::SaveCache() {
+
+    if (m_version.isEmpty()) {
+        return;
+    };
+
+    const QString filepath = m_data_dir + "/" + REPOE_CACHE_FILE;
+    QSaveFile file(filepath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        QLOG_ERROR() << "RePoE: error opening cache for writing:" << file.errorString();
+        return;
+    };
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << REPOE_CACHE_MAGIC << REPOE_CACHE_FORMAT << m_version;
+    SaveItemCategories(stream);
+    SaveStatTranslations(stream);
+
+    if ((stream.status() != QDataStream::Ok) || !file.commit()) {
+        QLOG_ERROR() << "RePoE: error writing cache:" << file.errorString();
+    };
+}
+
+QByteArray RePoE::ReadFile(const QString& filename) const {
     const QString filepath = m_data_dir + "/repoe/" + filename;
     QFile file(filepath);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
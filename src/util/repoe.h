@@ -43,11 +43,15 @@ public slots:
 private:
     void BeginUpdate();
     void RequestNextFile();
-    void FinishUpdate();
-    QByteArray ReadFile(const QString& filename);
+    void FinishUpdate(bool use_cache);
+    void ParseFiles();
+    bool LoadCache();
+    void SaveCache();
+    QByteArray ReadFile(const QString& filename) const;
 
     bool m_initialized;
     QNetworkAccessManager& m_network_manager;
     QString m_data_dir;
+    QString m_version;
     std::vector<QString> m_needed_files;
 };
@@ -73,6 +73,10 @@ void UpdateChecker::CheckForUpdates() {
     QLOG_TRACE() << "UpdateChecker: requesting GitHub releases:" << GITHUB_RELEASES_URL;
     QNetworkRequest request = QNetworkRequest(QUrl(GITHUB_RELEASES_URL));
     request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, USER_AGENT);
+
+    // Always ask GitHub, so a cached list of releases can't hide an update.
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
     QNetworkReply* reply = m_nm.get(request);
     connect(reply, &QNetworkReply::errorOccurred, this, &UpdateChecker::OnUpdateErrorOccurred);
     connect(reply, &QNetworkReply::sslErrors, this, &UpdateChecker::OnUpdateSslErrors);
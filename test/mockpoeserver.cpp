@@ -0,0 +1,582 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mockpoeserver.h"
+
+#include <QHttpHeaders>
+#include <QHttpServer>
+#include <QHttpServerRequest>
+#include <QHttpServerResponse>
+#include <QLocale>
+#include <QMutexLocker>
+#include <QNetworkRequest>
+#include <QTcpServer>
+#include <QTimeZone>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include <algorithm>
+
+#include <QsLog/QsLog.h>
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+namespace {
+
+    using JsonWriter = rapidjson::Writer<rapidjson::StringBuffer>;
+
+    // Policy names used for each group of endpoints.
+    constexpr const char* kLegacyItemPolicy = "backend-item-request-limit";
+    constexpr const char* kLegacyCharacterPolicy = "backend-character-request-limit";
+    constexpr const char* kOAuthStashPolicy = "stash-request-limit";
+    constexpr const char* kOAuthCharacterPolicy = "character-request-limit";
+
+    constexpr int kStashWidth = 12;
+
+    // Stash tabs from the OAuth api have ten character ids. The legacy api
+    // returns a 64 character id that starts with the same ten characters.
+    QString StashId(int index) {
+        return QString::number(0x1000000000LL + index, 16);
+    }
+
+    QString LegacyStashId(int index) {
+        return StashId(index).leftJustified(64, '0');
+    }
+
+    QString CharacterName(int index) {
+        return QString("MockCharacter%1").arg(index);
+    }
+
+    // Return the character index for a name, or -1 if it's not one of ours.
+    int CharacterIndex(const QString& name, int character_count) {
+        const QString prefix = "MockCharacter";
+        if (!name.startsWith(prefix)) {
+            return -1;
+        };
+        bool ok = false;
+        const int index = name.mid(prefix.size()).toInt(&ok);
+        return (ok && (index >= 0) && (index < character_count)) ? index : -1;
+    }
+
+    // Return the stash index for an OAuth stash id, or -1 if it's not one of ours.
+    int StashIndex(const QString& stash_id, int stash_count) {
+        bool ok = false;
+        const long long index = stash_id.toLongLong(&ok, 16) - 0x1000000000LL;
+        return (ok && (index >= 0) && (index < stash_count)) ? static_cast<int>(index) : -1;
+    }
+
+    void WriteString(JsonWriter& writer, const char* key, const QString& value) {
+        const QByteArray utf8 = value.toUtf8();
+        writer.Key(key);
+        writer.String(utf8.constData(), static_cast<rapidjson::SizeType>(utf8.size()));
+    }
+
+    // Write a rare ring with a few mods whose values depend on the seed,
+    // so that items are distinct but the data is deterministic.
+    void WriteItem(JsonWriter& writer, const QString& item_id, const QString& league,
+        const QString& inventory_id, int seed, int x, int y)
+    {
+        writer.StartObject();
+        writer.Key("verified"); writer.Bool(false);
+        writer.Key("w"); writer.Int(1);
+        writer.Key("h"); writer.Int(1);
+        WriteString(writer, "icon", "https://web.poecdn.com/image/Art/2DItems/Rings/Ring1.png");
+        WriteString(writer, "league", league);
+        WriteString(writer, "id", item_id);
+        WriteString(writer, "name", QString("Mock Loop %1").arg(seed));
+        WriteString(writer, "typeLine", "Ruby Ring");
+        WriteString(writer, "baseType", "Ruby Ring");
+        writer.Key("identified"); writer.Bool(true);
+        writer.Key("ilvl"); writer.Int(60 + (seed % 25));
+        writer.Key("frameType"); writer.Int(2);
+        writer.Key("x"); writer.Int(x);
+        writer.Key("y"); writer.Int(y);
+        WriteString(writer, "inventoryId", inventory_id);
+        writer.Key("implicitMods");
+        writer.StartArray();
+        writer.String(QString("+%1% to Fire Resistance").arg(20 + (seed % 11)).toUtf8().constData());
+        writer.EndArray();
+        writer.Key("explicitMods");
+        writer.StartArray();
+        writer.String(QString("+%1 to maximum Life").arg(40 + (seed % 40)).toUtf8().constData());
+        writer.String(QString("+%1% to Cold Resistance").arg(10 + (seed % 36)).toUtf8().constData());
+        writer.String(QString("+%1 to Strength").arg(5 + (seed % 50)).toUtf8().constData());
+        writer.EndArray();
+        writer.EndObject();
+    }
+
+    void WriteStashItems(JsonWriter& writer, int stash_index, int item_count, const QString& league) {
+        writer.StartArray();
+        for (int i = 0; i < item_count; ++i) {
+            const int seed = stash_index * item_count + i;
+            const QString item_id = QString("%1").arg(seed + 1, 64, 16, QChar('0'));
+            WriteItem(writer, item_id, league, QString("Stash%1").arg(stash_index + 1),
+                seed, i % kStashWidth, i / kStashWidth);
+        };
+        writer.EndArray();
+    }
+
+    void WriteCharacterItems(JsonWriter& writer, int character_index, int item_count, const QString& league) {
+        writer.StartArray();
+        for (int i = 0; i < item_count; ++i) {
+            const int seed = 1000000 + character_index * item_count + i;
+            const QString item_id = QString("%1").arg(seed, 64, 16, QChar('0'));
+            WriteItem(writer, item_id, league, "MainInventory", seed, i % kStashWidth, i / kStashWidth);
+        };
+        writer.EndArray();
+    }
+
+    QByteArray ToByteArray(const rapidjson::StringBuffer& buffer) {
+        return QByteArray(buffer.GetString(), static_cast<qsizetype>(buffer.GetSize()));
+    }
+
+    QHttpServerResponse NotFound() {
+        return QHttpServerResponse("application/json",
+            "{\"error\":{\"code\":1,\"message\":\"Resource not found\"}}",
+            QHttpServerResponse::StatusCode::NotFound);
+    }
+}
+
+double MockPoeServer::Stats::requests_per_second() const {
+    const qint64 msec = first_request.msecsTo(last_request);
+    if ((requests < 2) || (msec <= 0)) {
+        return 0.0;
+    };
+    return 1000.0 * (requests - 1) / msec;
+}
+
+MockPoeServer::MockPoeServer(const Options& options)
+    : QObject()
+    , m_options(options)
+    , m_context(nullptr)
+    , m_http_server(nullptr)
+    , m_tcp_server(nullptr)
+    , m_port(0)
+    , m_get_requests(0)
+{
+    // Parse the limits so the server can enforce them.
+    for (const auto& fragment : m_options.rate_limits.split(',')) {
+        const QByteArrayList parts = fragment.split(':');
+        if (parts.size() != 3) {
+            QLOG_ERROR() << "MockPoeServer: invalid rate limit fragment:" << fragment;
+            continue;
+        };
+        m_limits.push_back({ parts[0].toInt(), parts[1].toInt(), parts[2].toInt() });
+    };
+}
+
+MockPoeServer::~MockPoeServer() {
+    m_thread.quit();
+    m_thread.wait();
+}
+
+bool MockPoeServer::Start() {
+    QLOG_TRACE() << "MockPoeServer::Start() entered";
+    if (m_context) {
+        QLOG_ERROR() << "MockPoeServer: the server has already been started";
+        return false;
+    };
+
+    // The http server must be created on the thread it will run on.
+    m_context = new QObject;
+    m_context->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_context, &QObject::deleteLater);
+    m_thread.start();
+    QMetaObject::invokeMethod(m_context, [this]() { Listen(); }, Qt::BlockingQueuedConnection);
+    return (m_port != 0);
+}
+
+void MockPoeServer::Listen() {
+
+    m_http_server = new QHttpServer(m_context);
+
+    // Legacy endpoints.
+    m_http_server->route("/character-window/get-stash-items",
+        [this](const QHttpServerRequest& request) {
+            const QUrlQuery query(request.url());
+            const int tab_index = query.queryItemValue("tabIndex").toInt();
+            const bool include_tabs = (query.queryItemValue("tabs") == "1");
+            if ((tab_index < 0) || (tab_index >= m_options.stash_count)) {
+                return Reply(request, kLegacyItemPolicy, "{\"error\":{\"code\":1,\"message\":\"Resource not found\"}}");
+            };
+            return Reply(request, kLegacyItemPolicy, LegacyStash(tab_index, include_tabs));
+        });
+    m_http_server->route("/character-window/get-characters",
+        [this](const QHttpServerRequest& request) {
+            return Reply(request, kLegacyCharacterPolicy, LegacyCharacters());
+        });
+    m_http_server->route("/character-window/get-items",
+        [this](const QHttpServerRequest& request) {
+            const QString name = QUrlQuery(request.url()).queryItemValue("character");
+            return Reply(request, kLegacyItemPolicy, LegacyCharacter(name));
+        });
+    m_http_server->route("/character-window/get-passive-skills",
+        [this](const QHttpServerRequest& request) {
+            return Reply(request, kLegacyItemPolicy, "{\"hashes\":[],\"items\":[]}");
+        });
+    m_http_server->route("/",
+        [this](const QHttpServerRequest& request) {
+            Q_UNUSED(request);
+            return QHttpServerResponse("text/html", LegacyMainPage());
+        });
+
+    // OAuth endpoints. Only the pc realm is supported.
+    m_http_server->route("/stash/<arg>",
+        [this](const QString& league, const QHttpServerRequest& request) {
+            if (league != m_options.league) {
+                return NotFound();
+            };
+            return Reply(request, kOAuthStashPolicy, OAuthStashList());
+        });
+    m_http_server->route("/stash/<arg>/<arg>",
+        [this](const QString& league, const QString& stash_id, const QHttpServerRequest& request) {
+            if (league != m_options.league) {
+                return NotFound();
+            };
+            return Reply(request, kOAuthStashPolicy, OAuthStash(stash_id));
+        });
+    m_http_server->route("/character",
+        [this](const QHttpServerRequest& request) {
+            return Reply(request, kOAuthCharacterPolicy, OAuthCharacters());
+        });
+    m_http_server->route("/character/<arg>",
+        [this](const QString& name, const QHttpServerRequest& request) {
+            return Reply(request, kOAuthCharacterPolicy, OAuthCharacter(name));
+        });
+
+    m_http_server->setMissingHandler(m_context,
+        [](const QHttpServerRequest& request, QHttpServerResponder& responder) {
+            QLOG_WARN() << "MockPoeServer: unhandled request:" << request.url().toString();
+            responder.write(QHttpServerResponder::StatusCode::NotFound);
+        });
+
+    m_tcp_server = new QTcpServer(m_context);
+    if (!m_tcp_server->listen(QHostAddress::LocalHost)) {
+        QLOG_ERROR() << "MockPoeServer: cannot start tcp server";
+        return;
+    };
+    if (!m_http_server->bind(m_tcp_server)) {
+        QLOG_ERROR() << "MockPoeServer: cannot bind http server to tcp server";
+        return;
+    };
+    m_port = m_tcp_server->serverPort();
+    QLOG_DEBUG() << "MockPoeServer: listening on port" << m_port;
+}
+
+MockPoeServer::Stats MockPoeServer::stats() const {
+    QMutexLocker lock(&m_mutex);
+    return m_stats;
+}
+
+void MockPoeServer::ResetStats() {
+    QMutexLocker lock(&m_mutex);
+    m_stats = Stats();
+}
+
+QHttpServerResponse MockPoeServer::Reply(const QHttpServerRequest& request, const QByteArray& policy, const QByteArray& json) {
+
+    const bool head = (request.method() == QHttpServerRequest::Method::Head);
+
+    if (m_options.latency_msec > 0) {
+        // Replies are serialized on the server thread, which is close
+        // enough to how acquisition sends one request per policy at a time.
+        QThread::msleep(m_options.latency_msec);
+    };
+
+    QMutexLocker lock(&m_mutex);
+
+    const QDateTime timestamp = QDateTime::currentDateTimeUtc();
+    if (m_stats.requests == 0) {
+        m_stats.first_request = timestamp;
+    };
+    m_stats.last_request = timestamp;
+    ++m_stats.requests;
+
+    // The Date header only has a resolution of one second, so the limits are
+    // enforced at that resolution too. Otherwise a client that uses the Date
+    // header to track its history could never be sure it was within the limits.
+    const QDateTime now = QDateTime::fromSecsSinceEpoch(timestamp.toSecsSinceEpoch(), QTimeZone::UTC);
+
+    PolicyState& state = m_policies[policy];
+
+    // Forget hits that are older than the longest period.
+    int max_period = 0;
+    for (const auto& limit : m_limits) {
+        max_period = std::max(max_period, limit.period);
+    };
+    while (!state.hits.empty() && (state.hits.front().secsTo(now) >= max_period)) {
+        state.hits.pop_front();
+    };
+
+    int retry_after = 0;
+    if (state.restricted_until.isValid() && (now < state.restricted_until)) {
+        // Requests made while restricted are rejected without counting as hits.
+        retry_after = std::max(1LL, (now.msecsTo(state.restricted_until) + 999) / 1000);
+    } else {
+        state.hits.push_back(now);
+        for (const auto& limit : m_limits) {
+            const auto hits = std::count_if(state.hits.begin(), state.hits.end(),
+                [&](const QDateTime& hit) { return hit.secsTo(now) < limit.period; });
+            if (hits > limit.hits) {
+                retry_after = std::max(retry_after, limit.restriction);
+            };
+        };
+        // HEAD requests are used to discover policies, so never force a violation on them.
+        if ((m_options.forced_violation_interval > 0) && !head) {
+            if ((++m_get_requests % m_options.forced_violation_interval) == 0) {
+                retry_after = std::max(retry_after, m_options.forced_violation_sec);
+            };
+        };
+        if (retry_after > 0) {
+            state.restricted_until = now.addSecs(retry_after);
+        };
+    };
+
+    // Build the state header the same way GGG does: current hits, period, and active restriction.
+    QByteArrayList limit_fragments;
+    QByteArrayList state_fragments;
+    const int restriction = (state.restricted_until.isValid() && (now < state.restricted_until))
+        ? static_cast<int>((now.msecsTo(state.restricted_until) + 999) / 1000) : 0;
+    for (const auto& limit : m_limits) {
+        const auto hits = std::count_if(state.hits.begin(), state.hits.end(),
+            [&](const QDateTime& hit) { return hit.secsTo(now) < limit.period; });
+        limit_fragments.append(QByteArray::number(limit.hits) + ":" + QByteArray::number(limit.period) + ":" + QByteArray::number(limit.restriction));
+        state_fragments.append(QByteArray::number(hits) + ":" + QByteArray::number(limit.period) + ":" + QByteArray::number(restriction));
+    };
+
+    QHttpServerResponse response = (retry_after > 0)
+        ? QHttpServerResponse("application/json",
+            "{\"error\":{\"code\":3,\"message\":\"Rate limit exceeded\"}}",
+            QHttpServerResponse::StatusCode::TooManyRequests)
+        : QHttpServerResponse("application/json", head ? QByteArray() : json);
+
+    if (retry_after > 0) {
+        ++m_stats.violations;
+        QLOG_DEBUG() << "MockPoeServer: rate limit violation for" << policy;
+    };
+
+    QHttpHeaders headers = response.headers();
+    headers.append("Date", QLocale::c().toString(now, "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toLatin1());
+    headers.append("X-Rate-Limit-Policy", policy);
+    headers.append("X-Rate-Limit-Rules", "Account");
+    headers.append("X-Rate-Limit-Account", limit_fragments.join(','));
+    headers.append("X-Rate-Limit-Account-State", state_fragments.join(','));
+    if (retry_after > 0) {
+        headers.append("Retry-After", QByteArray::number(retry_after));
+    };
+    response.setHeaders(std::move(headers));
+    return response;
+}
+
+QByteArray MockPoeServer::LegacyStash(int tab_index, bool include_tabs) const {
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer(buffer);
+    writer.StartObject();
+    writer.Key("numTabs");
+    writer.Int(m_options.stash_count);
+    if (include_tabs) {
+        writer.Key("tabs");
+        writer.StartArray();
+        for (int i = 0; i < m_options.stash_count; ++i) {
+            writer.StartObject();
+            WriteString(writer, "n", QString("Tab %1").arg(i + 1));
+            writer.Key("i"); writer.Int(i);
+            WriteString(writer, "id", LegacyStashId(i));
+            WriteString(writer, "type", "NormalStash");
+            writer.Key("hidden"); writer.Bool(false);
+            writer.Key("selected"); writer.Bool(i == 0);
+            writer.Key("colour");
+            writer.StartObject();
+            writer.Key("r"); writer.Int((i * 40) % 256);
+            writer.Key("g"); writer.Int((i * 80) % 256);
+            writer.Key("b"); writer.Int((i * 120) % 256);
+            writer.EndObject();
+            writer.EndObject();
+        };
+        writer.EndArray();
+    };
+    writer.Key("items");
+    WriteStashItems(writer, tab_index, m_options.items_per_stash, m_options.league);
+    writer.EndObject();
+    return ToByteArray(buffer);
+}
+
+QByteArray MockPoeServer::LegacyCharacters() const {
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer(buffer);
+    writer.StartArray();
+    for (int i = 0; i < m_options.character_count; ++i) {
+        writer.StartObject();
+        WriteString(writer, "name", CharacterName(i));
+        WriteString(writer, "league", m_options.league);
+        writer.Key("classId"); writer.Int(1);
+        writer.Key("ascendancyClass"); writer.Int(0);
+        WriteString(writer, "class", "Marauder");
+        writer.Key("level"); writer.Int(90);
+        writer.Key("experience"); writer.Int(0);
+        if (i == 0) {
+            writer.Key("lastActive"); writer.Bool(true);
+        };
+        writer.EndObject();
+    };
+    writer.EndArray();
+    return ToByteArray(buffer);
+}
+
+QByteArray MockPoeServer::LegacyCharacter(const QString& name) const {
+    const int index = CharacterIndex(name, m_options.character_count);
+    if (index < 0) {
+        return "{\"error\":{\"code\":1,\"message\":\"Resource not found\"}}";
+    };
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer(buffer);
+    writer.StartObject();
+    writer.Key("items");
+    WriteCharacterItems(writer, index, m_options.items_per_character, m_options.league);
+    writer.Key("character");
+    writer.StartObject();
+    WriteString(writer, "name", name);
+    WriteString(writer, "league", m_options.league);
+    WriteString(writer, "class", "Marauder");
+    writer.Key("level"); writer.Int(90);
+    writer.EndObject();
+    writer.EndObject();
+    return ToByteArray(buffer);
+}
+
+QByteArray MockPoeServer::LegacyMainPage() const {
+    // Acquisition looks for the selected character in an inline script.
+    const QString name = (m_options.character_count > 0) ? CharacterName(0) : QString();
+    return QString("<html><body><script>C({\"name\":\"%1\",\"class\":\"Marauder\"});</script></body></html>").arg(name).toUtf8();
+}
+
+QByteArray MockPoeServer::OAuthStashList() const {
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer(buffer);
+    writer.StartObject();
+    writer.Key("stashes");
+    writer.StartArray();
+    for (int i = 0; i < m_options.stash_count; ++i) {
+        writer.StartObject();
+        WriteString(writer, "id", StashId(i));
+        WriteString(writer, "name", QString("Tab %1").arg(i + 1));
+        WriteString(writer, "type", "NormalStash");
+        writer.Key("index"); writer.Int(i);
+        writer.Key("metadata");
+        writer.StartObject();
+        WriteString(writer, "colour", "7c5436");
+        writer.EndObject();
+        writer.EndObject();
+    };
+    writer.EndArray();
+    writer.EndObject();
+    return ToByteArray(buffer);
+}
+
+QByteArray MockPoeServer::OAuthStash(const QString& stash_id) const {
+    const int index = StashIndex(stash_id, m_options.stash_count);
+    if (index < 0) {
+        return "{\"error\":{\"code\":1,\"message\":\"Resource not found\"}}";
+    };
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer(buffer);
+    writer.StartObject();
+    writer.Key("stash");
+    writer.StartObject();
+    WriteString(writer, "id", stash_id);
+    WriteString(writer, "name", QString("Tab %1").arg(index + 1));
+    WriteString(writer, "type", "NormalStash");
+    writer.Key("index"); writer.Int(index);
+    writer.Key("metadata");
+    writer.StartObject();
+    WriteString(writer, "colour", "7c5436");
+    writer.EndObject();
+    writer.Key("items");
+    WriteStashItems(writer, index, m_options.items_per_stash, m_options.league);
+    writer.EndObject();
+    writer.EndObject();
+    return ToByteArray(buffer);
+}
+
+QByteArray MockPoeServer::OAuthCharacters() const {
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer(buffer);
+    writer.StartObject();
+    writer.Key("characters");
+    writer.StartArray();
+    for (int i = 0; i < m_options.character_count; ++i) {
+        writer.StartObject();
+        WriteString(writer, "id", StashId(1000 + i));
+        WriteString(writer, "name", CharacterName(i));
+        WriteString(writer, "realm", "pc");
+        WriteString(writer, "class", "Marauder");
+        WriteString(writer, "league", m_options.league);
+        writer.Key("level"); writer.Int(90);
+        writer.Key("experience"); writer.Int(0);
+        writer.EndObject();
+    };
+    writer.EndArray();
+    writer.EndObject();
+    return ToByteArray(buffer);
+}
+
+QByteArray MockPoeServer::OAuthCharacter(const QString& name) const {
+    const int index = CharacterIndex(name, m_options.character_count);
+    if (index < 0) {
+        return "{\"error\":{\"code\":1,\"message\":\"Resource not found\"}}";
+    };
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer(buffer);
+    writer.StartObject();
+    writer.Key("character");
+    writer.StartObject();
+    WriteString(writer, "id", StashId(1000 + index));
+    WriteString(writer, "name", name);
+    WriteString(writer, "realm", "pc");
+    WriteString(writer, "class", "Marauder");
+    WriteString(writer, "league", m_options.league);
+    writer.Key("level"); writer.Int(90);
+    writer.Key("experience"); writer.Int(0);
+    writer.Key("equipment"); writer.StartArray(); writer.EndArray();
+    writer.Key("inventory");
+    WriteCharacterItems(writer, index, m_options.items_per_character, m_options.league);
+    writer.Key("jewels"); writer.StartArray(); writer.EndArray();
+    writer.EndObject();
+    writer.EndObject();
+    return ToByteArray(buffer);
+}
+
+MockNetworkAccessManager::MockNetworkAccessManager(quint16 port)
+    : QNetworkAccessManager()
+    , m_port(port)
+{}
+
+QNetworkReply* MockNetworkAccessManager::createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoing_data) {
+    QUrl url = request.url();
+    if ((url.host() == "pathofexile.com") || url.host().endsWith(".pathofexile.com")) {
+        url.setScheme("http");
+        url.setHost("127.0.0.1");
+        url.setPort(m_port);
+        QNetworkRequest redirected(request);
+        redirected.setUrl(url);
+        return QNetworkAccessManager::createRequest(op, redirected, outgoing_data);
+    };
+    return QNetworkAccessManager::createRequest(op, request, outgoing_data);
+}
@@ -0,0 +1,145 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QMutex>
+#include <QNetworkAccessManager>
+#include <QObject>
+#include <QThread>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+class QHttpServer;
+class QHttpServerRequest;
+class QHttpServerResponse;
+class QTcpServer;
+
+// A local stand-in for the parts of the Path of Exile API that acquisition
+// uses to fetch items. Both the legacy character-window endpoints and the
+// OAuth endpoints are served with synthetic stash tabs and characters.
+//
+// Every reply carries X-Rate-Limit-* headers for the configured limits, and
+// the server keeps track of hits the same way GGG does, so a client that
+// exceeds a limit gets a 429 with a Retry-After header. This makes it possible
+// to measure the whole fetch pipeline offline and deterministically.
+//
+// The server runs on its own thread so that simulated latency does not block
+// the client's event loop.
+class MockPoeServer : public QObject {
+    Q_OBJECT
+public:
+
+    struct Options {
+        int stash_count{ 10 };
+        int items_per_stash{ 25 };
+        int character_count{ 2 };
+        int items_per_character{ 10 };
+
+        // Delay added before every reply.
+        int latency_msec{ 0 };
+
+        // Sent as the X-Rate-Limit-Account header and enforced by the server.
+        QByteArray rate_limits{ "45:60:60,240:240:900" };
+
+        // When positive, every Nth request is rejected with a 429.
+        int forced_violation_interval{ 0 };
+
+        // Retry-After for forced violations.
+        int forced_violation_sec{ 1 };
+
+        QString league{ "Standard" };
+    };
+
+    struct Stats {
+        int requests{ 0 };
+        int violations{ 0 };
+        QDateTime first_request;
+        QDateTime last_request;
+        double requests_per_second() const;
+    };
+
+    explicit MockPoeServer(const Options& options);
+    ~MockPoeServer();
+
+    // Start listening on a random local port.
+    bool Start();
+
+    quint16 port() const { return m_port; };
+    const Options& options() const { return m_options; };
+
+    Stats stats() const;
+    void ResetStats();
+
+private:
+
+    struct Limit {
+        int hits;
+        int period;
+        int restriction;
+    };
+
+    struct PolicyState {
+        std::deque<QDateTime> hits;
+        QDateTime restricted_until;
+    };
+
+    void Listen();
+
+    QHttpServerResponse Reply(const QHttpServerRequest& request, const QByteArray& policy, const QByteArray& json);
+
+    QByteArray LegacyStash(int tab_index, bool include_tabs) const;
+    QByteArray LegacyCharacters() const;
+    QByteArray LegacyCharacter(const QString& name) const;
+    QByteArray LegacyMainPage() const;
+    QByteArray OAuthStashList() const;
+    QByteArray OAuthStash(const QString& stash_id) const;
+    QByteArray OAuthCharacters() const;
+    QByteArray OAuthCharacter(const QString& name) const;
+
+    const Options m_options;
+    std::vector<Limit> m_limits;
+
+    QThread m_thread;
+    QObject* m_context;
+    QHttpServer* m_http_server;
+    QTcpServer* m_tcp_server;
+    quint16 m_port;
+
+    mutable QMutex m_mutex;
+    Stats m_stats;
+    int m_get_requests;
+    std::map<QByteArray, PolicyState> m_policies;
+};
+
+// A network access manager that sends every request for a pathofexile.com
+// host to a MockPoeServer instead.
+class MockNetworkAccessManager : public QNetworkAccessManager {
+    Q_OBJECT
+public:
+    explicit MockNetworkAccessManager(quint16 port);
+protected:
+    QNetworkReply* createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoing_data) override;
+private:
+    const quint16 m_port;
+};
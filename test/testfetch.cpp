@@ -0,0 +1,384 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testfetch.h"
+
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSettings>
+#include <QSignalSpy>
+#include <QTemporaryFile>
+#include <QTest>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <boost/circular_buffer.hpp>
+#include <QsLog/QsLog.h>
+
+#include "buyoutmanager.h"
+#include "datastore/memorydatastore.h"
+#include "itemsmanagerworker.h"
+#include "ratelimit/ratelimitedreply.h"
+#include "ratelimit/ratelimiter.h"
+#include "ratelimit/ratelimitmanager.h"
+#include "ratelimit/ratelimitpolicy.h"
+#include "ratelimit/ratelimitsnapshot.h"
+#include "util/oauthmanager.h"
+#include "util/util.h"
+#include "mockpoeserver.h"
+
+namespace {
+
+    constexpr const char* kStashItemsUrl = "https://www.pathofexile.com/character-window/get-stash-items";
+
+    // Submit requests for the first tab_count stash tabs, one tab after
+    // another until count requests have been submitted, and return the
+    // number of completed replies.
+    std::shared_ptr<int> SubmitStashRequests(RateLimiter& rate_limiter, int count, int tab_count) {
+        auto completed = std::make_shared<int>(0);
+        for (int i = 0; i < count; ++i) {
+            QUrlQuery query;
+            query.addQueryItem("accountName", "MockAccount");
+            query.addQueryItem("realm", "pc");
+            query.addQueryItem("league", "Standard");
+            query.addQueryItem("tabs", "0");
+            query.addQueryItem("tabIndex", QString::number(i % tab_count));
+            QUrl url(kStashItemsUrl);
+            url.setQuery(query);
+            RateLimitedReply* reply = rate_limiter.Submit(kStashItemsUrl, QNetworkRequest(url));
+            QObject::connect(reply, &RateLimitedReply::complete, reply,
+                [=](QNetworkReply* network_reply) {
+                    if (network_reply->error() == QNetworkReply::NoError) {
+                        ++(*completed);
+                    };
+                    network_reply->deleteLater();
+                    reply->deleteLater();
+                });
+        };
+        return completed;
+    }
+
+    // The most sends that fall within any one period of a rule.
+    int MaxSendsInWindow(const std::vector<QDateTime>& plan, qint64 period_msec) {
+        int result = 0;
+        for (size_t i = 0; i < plan.size(); ++i) {
+            int sends = 0;
+            for (size_t j = i; (j < plan.size()) && (plan[i].msecsTo(plan[j]) < period_msec); ++j) {
+                ++sends;
+            };
+            result = std::max(result, sends);
+        };
+        return result;
+    }
+
+    void LogStats(const char* name, const MockPoeServer::Stats& stats, qint64 elapsed_msec) {
+        QLOG_INFO() << name << ":"
+            << stats.requests << "requests in" << elapsed_msec << "msec,"
+            << stats.requests_per_second() << "requests/sec,"
+            << stats.violations << "violations";
+    }
+}
+
+TestFetch::TestFetch(RePoE& repoe)
+    : QObject()
+    , m_repoe(repoe)
+{}
+
+// Plan batches against a policy with a short and a long rule, and make sure
+// the batch is paced to stay within both and the queue ETA matches the plan.
+void TestFetch::RateLimitPlanning() {
+
+    // This must match the minimum interval used by RateLimitManager.
+    constexpr int minimum_delay_msec = 250;
+
+    RateLimitSnapshot snapshot;
+    snapshot.policy = "mock-policy";
+    RateLimitSnapshot::Rule rule;
+    rule.name = "Ip";
+    rule.limit = "5:10:60,10:600:1800";
+    rule.state = "0:10:0,0:600:0";
+    snapshot.rules.push_back(rule);
+
+    const RateLimitPolicy policy(snapshot);
+    const boost::circular_buffer<QDateTime> history(policy.maximum_hits());
+
+    // A batch that fits within both rules is sent at the minimum interval.
+    const QDateTime before = QDateTime::currentDateTime();
+    const std::vector<QDateTime> burst = policy.PlanSends(history, 3, minimum_delay_msec);
+    QCOMPARE(burst.size(), size_t(3));
+    QVERIFY(burst[0] >= before);
+    QVERIFY(burst[0] <= QDateTime::currentDateTime());
+    QCOMPARE(burst[0].msecsTo(burst[1]), minimum_delay_msec);
+    QCOMPARE(burst[1].msecsTo(burst[2]), minimum_delay_msec);
+
+    // A batch that doesn't fit in the long rule is spread out over it.
+    constexpr int request_count = 12;
+    const std::vector<QDateTime> plan = policy.PlanSends(history, request_count, minimum_delay_msec);
+    QCOMPARE(plan.size(), size_t(request_count));
+    for (size_t i = 1; i < plan.size(); ++i) {
+        QVERIFY(plan[i - 1].msecsTo(plan[i]) >= minimum_delay_msec);
+    };
+    QVERIFY(MaxSendsInWindow(plan, 10 * 1000) <= 5);
+    QVERIFY(MaxSendsInWindow(plan, 600 * 1000) <= 10);
+    QVERIFY(plan.front().msecsTo(plan[10]) >= 600 * 1000);
+
+    // The manager reports the last planned send of its queue as the ETA. Requests
+    // queued behind the active one are added to the end of the plan one at a
+    // time, so the ETA can be earlier than planning them all at once, but it
+    // must still respect the long rule.
+    RateLimitManager manager([](QNetworkRequest&) -> QNetworkReply* { return nullptr; });
+    manager.Restore(snapshot);
+    QSignalSpy spy(&manager, &RateLimitManager::QueueUpdated);
+    for (int i = 0; i < request_count; ++i) {
+        const QUrl url(QString("https://www.pathofexile.com/mock/%1").arg(i));
+        manager.QueueRequest("mock", QNetworkRequest(url), new RateLimitedReply());
+    };
+    QCOMPARE(spy.size(), request_count);
+    const QDateTime estimated_finish = spy.last().at(2).toDateTime();
+    QVERIFY(plan.front().msecsTo(estimated_finish) >= 600 * 1000);
+    QVERIFY(estimated_finish.msecsTo(plan.back()) > -1000);
+
+    RateLimitPlanner planner(policy, history, minimum_delay_msec);
+    QDateTime expected_finish;
+    for (int i = 0; i < request_count; ++i) {
+        expected_finish = planner.PlanNext(1);
+    };
+    QVERIFY(qAbs(expected_finish.msecsTo(estimated_finish)) < 1000);
+}
+
+// Restore a saved policy with a restriction and make sure it's saved
+// again unchanged, along with its history.
+void TestFetch::RateLimiterStateRoundTrip() {
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    RateLimitSnapshot saved;
+    saved.policy = "backend-item-request-limit";
+    saved.endpoints = { kStashItemsUrl };
+    RateLimitSnapshot::Rule rule;
+    rule.name = "Ip";
+    rule.limit = "45:60:60,240:240:900";
+    rule.state = "46:60:60,50:240:0";
+    saved.rules.push_back(rule);
+    saved.history = { now - 1000, now - 2000, now - 3000 };
+
+    // This is the key the rate limiter uses for the legacy API.
+    const QString key = "rate_limit_state_legacy";
+    MemoryDataStore datastore;
+    datastore.Set(key, QString::fromStdString(JS::serializeStruct(std::vector<RateLimitSnapshot>{ saved })));
+
+    {
+        QNetworkAccessManager network_manager;
+        OAuthManager oauth_manager(network_manager, datastore);
+        RateLimiter rate_limiter(network_manager, oauth_manager, datastore, POE_API::LEGACY);
+
+        // Clear the saved state so that what's read back below can only
+        // have been written when the rate limiter was destroyed.
+        datastore.Set(key, "");
+    };
+
+    const auto snapshots = Util::parseJson<std::vector<RateLimitSnapshot>>(datastore.Get(key));
+    QCOMPARE(snapshots.size(), size_t(1));
+    const RateLimitSnapshot& restored = snapshots[0];
+    QCOMPARE(restored.policy, saved.policy);
+    QCOMPARE(restored.endpoints, saved.endpoints);
+    QCOMPARE(restored.rules.size(), size_t(1));
+    QCOMPARE(restored.rules[0].name, rule.name);
+    QCOMPARE(restored.rules[0].limit, rule.limit);
+    QCOMPARE(restored.rules[0].state, rule.state);
+    QCOMPARE(restored.history, saved.history);
+
+    // The restriction from the saved state is part of the restored policy.
+    const RateLimitPolicy policy(restored);
+    QCOMPARE(policy.status(), RateLimitPolicy::Status::VIOLATION);
+    QCOMPARE(policy.rules()[0].items()[0].state().restriction(), 60);
+}
+
+// Queue more requests than the limit allows and make sure the rate
+// limiter paces them instead of triggering a violation.
+void TestFetch::RateLimiterThroughput() {
+
+    constexpr int request_count = 8;
+
+    MockPoeServer::Options options;
+    options.stash_count = request_count;
+    options.rate_limits = "4:2:10";
+    MockPoeServer server(options);
+    QVERIFY2(server.Start(), "The mock server did not start");
+
+    MockNetworkAccessManager network_manager(server.port());
+    MemoryDataStore datastore;
+    OAuthManager oauth_manager(network_manager, datastore);
+    RateLimiter rate_limiter(network_manager, oauth_manager, datastore, POE_API::LEGACY);
+
+    QElapsedTimer timer;
+    timer.start();
+    const auto completed = SubmitStashRequests(rate_limiter, request_count, request_count);
+    QTRY_COMPARE_WITH_TIMEOUT(*completed, request_count, 60000);
+    const qint64 elapsed = timer.elapsed();
+
+    const auto stats = server.stats();
+    LogStats("RateLimiterThroughput", stats, elapsed);
+    QTest::setBenchmarkResult(static_cast<qreal>(elapsed), QTest::WalltimeMilliseconds);
+    QCOMPARE(stats.violations, 0);
+}
+
+// Force a violation and make sure the request that was rejected is retried
+// and still completed.
+void TestFetch::RateLimiterViolationRecovery() {
+
+    MockPoeServer::Options options;
+    options.stash_count = 4;
+    options.rate_limits = "100:10:10";
+    options.forced_violation_interval = 3;
+    options.forced_violation_sec = 1;
+    MockPoeServer server(options);
+    QVERIFY2(server.Start(), "The mock server did not start");
+
+    MockNetworkAccessManager network_manager(server.port());
+    MemoryDataStore datastore;
+    OAuthManager oauth_manager(network_manager, datastore);
+    RateLimiter rate_limiter(network_manager, oauth_manager, datastore, POE_API::LEGACY);
+
+    constexpr int request_count = 4;
+    const auto completed = SubmitStashRequests(rate_limiter, request_count, request_count);
+    QTRY_COMPARE_WITH_TIMEOUT(*completed, request_count, 60000);
+    QCOMPARE(server.stats().violations, 1);
+}
+
+// Submit the same request several times and make sure it's only sent once,
+// but every caller gets the whole reply.
+void TestFetch::RateLimiterCoalescing() {
+
+    MockPoeServer::Options options;
+    options.stash_count = 1;
+    MockPoeServer server(options);
+    QVERIFY2(server.Start(), "The mock server did not start");
+
+    MockNetworkAccessManager network_manager(server.port());
+    MemoryDataStore datastore;
+    OAuthManager oauth_manager(network_manager, datastore);
+    RateLimiter rate_limiter(network_manager, oauth_manager, datastore, POE_API::LEGACY);
+
+    constexpr int request_count = 3;
+    QUrlQuery query;
+    query.addQueryItem("tabs", "1");
+    query.addQueryItem("tabIndex", "0");
+    QUrl url(kStashItemsUrl);
+    url.setQuery(query);
+
+    std::vector<QByteArray> bodies;
+    for (int i = 0; i < request_count; ++i) {
+        RateLimitedReply* reply = rate_limiter.Submit(kStashItemsUrl, QNetworkRequest(url));
+        connect(reply, &RateLimitedReply::complete, reply,
+            [&bodies, reply](QNetworkReply* network_reply) {
+                bodies.push_back(network_reply->readAll());
+                network_reply->deleteLater();
+                reply->deleteLater();
+            });
+    };
+    QTRY_COMPARE_WITH_TIMEOUT(static_cast<int>(bodies.size()), request_count, 10000);
+
+    // One HEAD request to discover the policy and one GET.
+    QCOMPARE(server.stats().requests, 2);
+    QVERIFY(!bodies[0].isEmpty());
+    for (const auto& body : bodies) {
+        QCOMPARE(body, bodies[0]);
+    };
+}
+
+// Submit every tab twice and make sure each tab is only fetched once.
+void TestFetch::RateLimiterCoalescingTabs() {
+
+    constexpr int tab_count = 4;
+    constexpr int request_count = 2 * tab_count;
+
+    MockPoeServer::Options options;
+    options.stash_count = tab_count;
+    MockPoeServer server(options);
+    QVERIFY2(server.Start(), "The mock server did not start");
+
+    MockNetworkAccessManager network_manager(server.port());
+    MemoryDataStore datastore;
+    OAuthManager oauth_manager(network_manager, datastore);
+    RateLimiter rate_limiter(network_manager, oauth_manager, datastore, POE_API::LEGACY);
+
+    const auto completed = SubmitStashRequests(rate_limiter, request_count, tab_count);
+    QTRY_COMPARE_WITH_TIMEOUT(*completed, request_count, 60000);
+
+    // One HEAD request to discover the policy and one GET per tab.
+    QCOMPARE(server.stats().requests, 1 + tab_count);
+}
+
+// Time a full refresh of every stash tab and character.
+void TestFetch::LegacyFullRefresh() {
+
+    MockPoeServer::Options options;
+    options.stash_count = 6;
+    options.items_per_stash = 40;
+    options.character_count = 2;
+    options.items_per_character = 12;
+    options.latency_msec = 20;
+    options.rate_limits = "45:60:60,240:240:900";
+    MockPoeServer server(options);
+    QVERIFY2(server.Start(), "The mock server did not start");
+
+    auto tmp = std::make_unique<QTemporaryFile>();
+    tmp->open();
+    QSettings settings(tmp->fileName(), QSettings::IniFormat);
+    settings.setValue("account", "MockAccount");
+    settings.setValue("realm", "pc");
+    settings.setValue("league", options.league);
+
+    MockNetworkAccessManager network_manager(server.port());
+    MemoryDataStore datastore;
+    OAuthManager oauth_manager(network_manager, datastore);
+    RateLimiter rate_limiter(network_manager, oauth_manager, datastore, POE_API::LEGACY);
+    BuyoutManager buyout_manager(datastore);
+    ItemsManagerWorker worker(settings, network_manager, m_repoe, buyout_manager, datastore, rate_limiter, POE_API::LEGACY);
+
+    QSignalSpy spy(&worker, &ItemsManagerWorker::ItemsRefreshed);
+
+    // Wait for the (empty) cache to be loaded.
+    worker.Init();
+    QTRY_COMPARE_WITH_TIMEOUT(spy.size(), 1, 10000);
+    spy.clear();
+
+    QElapsedTimer timer;
+    timer.start();
+    worker.Update(TabSelection::All);
+    QTRY_COMPARE_WITH_TIMEOUT(spy.size(), 1, 120000);
+    const qint64 elapsed = timer.elapsed();
+
+    const auto stats = server.stats();
+    LogStats("LegacyFullRefresh", stats, elapsed);
+    QTest::setBenchmarkResult(static_cast<qreal>(elapsed), QTest::WalltimeMilliseconds);
+
+    const Items items = spy.at(0).at(0).value<Items>();
+    const int expected = options.stash_count * options.items_per_stash
+        + options.character_count * options.items_per_character;
+    QCOMPARE(static_cast<int>(items.size()), expected);
+    QCOMPARE(stats.violations, 0);
+}
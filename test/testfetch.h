@@ -0,0 +1,42 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+
+class RePoE;
+
+// Benchmarks for the item fetching pipeline, run against a local mock
+// of the Path of Exile API so that results are repeatable.
+class TestFetch : public QObject {
+    Q_OBJECT
+public:
+    explicit TestFetch(RePoE& repoe);
+private slots:
+    void RateLimitPlanning();
+    void RateLimiterStateRoundTrip();
+    void RateLimiterThroughput();
+    void RateLimiterViolationRecovery();
+    void RateLimiterCoalescing();
+    void RateLimiterCoalescingTabs();
+    void LegacyFullRefresh();
+private:
+    RePoE& m_repoe;
+};
@@ -0,0 +1,166 @@
+/*
+    Copyright (C) 2014-2024 Acquisition Contributors
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testimagepack.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "imagepack.h"
+
+// The sizes of the file header and of each record header.
+constexpr qint64 kFileHeaderSize = 8;
+constexpr qint64 kRecordHeaderSize = 20;
+
+static bool WriteFile(const QString& path, const QByteArray& data) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && (file.write(data) == data.size());
+}
+
+// Checks that images can be replaced and removed, and that the pack
+// reads back the same way after it's reopened.
+void TestImagePack::WriteReadRemove() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("images.pack");
+    const QByteArray first = ImagePack::Key("https://example.com/first.png");
+    const QByteArray second = ImagePack::Key("https://example.com/second.png");
+
+    qint64 garbage = 0;
+    {
+        ImagePack pack(filename);
+        QCOMPARE(pack.count(), 0);
+        QVERIFY(pack.write(first, "first"));
+        QVERIFY(pack.write(second, "second"));
+        QVERIFY(pack.contains(first));
+        QCOMPARE(pack.read(first), QByteArray("first"));
+        QCOMPARE(pack.read(second), QByteArray("second"));
+        QCOMPARE(pack.garbage(), qint64(0));
+
+        // Invalid keys and empty images aren't stored.
+        QVERIFY(!pack.write("short", "data"));
+        QVERIFY(!pack.write(first, QByteArray()));
+
+        QVERIFY(pack.write(first, "replaced"));
+        pack.remove(second);
+        QCOMPARE(pack.read(first), QByteArray("replaced"));
+        QVERIFY(!pack.contains(second));
+        QVERIFY(pack.read(second).isEmpty());
+        QCOMPARE(pack.count(), 1);
+        garbage = pack.garbage();
+        QVERIFY(garbage > 0);
+    };
+
+    ImagePack pack(filename);
+    QCOMPARE(pack.count(), 1);
+    QCOMPARE(pack.read(first), QByteArray("replaced"));
+    QVERIFY(!pack.contains(second));
+    QCOMPARE(pack.garbage(), garbage);
+}
+
+// Checks that a record that was only partly written is dropped when the
+// pack is opened, and the records before it are kept.
+void TestImagePack::TruncatedRecord() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("images.pack");
+    const QByteArray first = ImagePack::Key("https://example.com/first.png");
+    const QByteArray second = ImagePack::Key("https://example.com/second.png");
+    {
+        ImagePack pack(filename);
+        QVERIFY(pack.write(first, "first"));
+        QVERIFY(pack.write(second, "second"));
+    };
+
+    QFile file(filename);
+    QVERIFY(file.resize(file.size() - 2));
+
+    ImagePack pack(filename);
+    QCOMPARE(pack.count(), 1);
+    QCOMPARE(pack.read(first), QByteArray("first"));
+    QVERIFY(!pack.contains(second));
+    QCOMPARE(pack.size(), kFileHeaderSize + kRecordHeaderSize + 5);
+
+    // New records go after the last complete one.
+    QVERIFY(pack.write(second, "again"));
+    QCOMPARE(pack.read(second), QByteArray("again"));
+}
+
+// Checks that compacting drops replaced and removed records, and keeps
+// every image that's still in the pack.
+void TestImagePack::Compact() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("images.pack");
+    const QByteArray first = ImagePack::Key("https://example.com/first.png");
+    const QByteArray second = ImagePack::Key("https://example.com/second.png");
+    const QByteArray third = ImagePack::Key("https://example.com/third.png");
+    {
+        ImagePack pack(filename);
+        QVERIFY(pack.write(first, "first"));
+        QVERIFY(pack.write(second, "second"));
+        QVERIFY(pack.write(first, "replaced"));
+        QVERIFY(pack.write(third, "third"));
+        pack.remove(second);
+        QVERIFY(pack.garbage() > 0);
+
+        QVERIFY(pack.Compact());
+        QCOMPARE(pack.garbage(), qint64(0));
+        QCOMPARE(pack.size(), kFileHeaderSize + (kRecordHeaderSize + 8) + (kRecordHeaderSize + 5));
+        QCOMPARE(pack.count(), 2);
+        QCOMPARE(pack.read(first), QByteArray("replaced"));
+        QCOMPARE(pack.read(third), QByteArray("third"));
+        QVERIFY(!pack.contains(second));
+
+        // The pack can still be written after it has been compacted.
+        QVERIFY(pack.write(second, "second"));
+    };
+
+    ImagePack pack(filename);
+    QCOMPARE(pack.count(), 3);
+    QCOMPARE(pack.read(first), QByteArray("replaced"));
+    QCOMPARE(pack.read(second), QByteArray("second"));
+    QCOMPARE(pack.read(third), QByteArray("third"));
+    QCOMPARE(pack.garbage(), qint64(0));
+}
+
+// Checks that images from the old cache directory are moved into the pack,
+// and that files that aren't cached images are left alone.
+void TestImagePack::Import() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QByteArray image = ImagePack::Key("https://example.com/image.png");
+    const QByteArray failed = ImagePack::Key("https://example.com/failed.png");
+    const QString image_path = dir.filePath(QString::fromLatin1(image.toHex()) + ".png");
+    const QString failed_path = dir.filePath(QString::fromLatin1(failed.toHex()) + ".png");
+    const QString other_path = dir.filePath("other.png");
+    QVERIFY(WriteFile(image_path, "image"));
+    QVERIFY(WriteFile(failed_path, QByteArray()));
+    QVERIFY(WriteFile(other_path, "other"));
+
+    ImagePack pack(dir.filePath("images.pack"));
+    QCOMPARE(pack.Import(dir.path()), 1);
+    QCOMPARE(pack.count(), 1);
+    QCOMPARE(pack.read(image), QByteArray("image"));
+    QVERIFY(!pack.contains(failed));
+    QVERIFY(!QFile::exists(image_path));
+    QVERIFY(!QFile::exists(failed_path));
+    QVERIFY(QFile::exists(other_path));
+}
@@ -25,6 +25,7 @@
 #include <rapidjson/document.h>
 #include <rapidjson/error/en.h>
 
+#include "modlist.h"
 #include "testdata.h"
 
 void TestItem::testBasicParsing() {
@@ -58,6 +59,76 @@ void TestItem::testBasicParsing() {
     QCOMPARE(item.old_hash(), "fb915d79d2659e9175afae12612da584");
 }
 
+void TestItem::testModMatcher() {
+
+    ModMatcher matcher;
+    matcher.Add("+# to maximum Life");
+    matcher.Add("+#% to Fire Resistance");
+    matcher.Add("Adds # to # Physical Damage");
+
+    const auto match = [&](const QByteArray& mod, double* value) {
+        return matcher.Match(mod.constData(), mod.size(), value);
+    };
+
+    double value = 0.0;
+    QCOMPARE(match("+32 to maximum Life", &value), 0);
+    QCOMPARE(value, 32.0);
+    QCOMPARE(match("+12% to Fire Resistance", &value), 1);
+    QCOMPARE(value, 12.0);
+    QCOMPARE(match("Adds 1.5 to 3.5 Physical Damage", &value), 2);
+    QCOMPARE(value, 2.5);
+
+    // Partial matches and literal placeholders are not matches.
+    QCOMPARE(match("+32 to maximum Lif", &value), -1);
+    QCOMPARE(match("+32 to maximum Life and Mana", &value), -1);
+    QCOMPARE(match("+# to maximum Life", &value), -1);
+}
+
+void TestItem::testModTable() {
+
+    ModTable table;
+    table.Set(7, 1.0);
+    table.Set(2, 2.0);
+    table.Set(5, 3.0);
+    table.Set(2, 4.0);
+
+    // Mods are kept sorted by id and setting a mod again replaces its value.
+    QCOMPARE(table.size(), size_t(3));
+    QCOMPARE(table.begin()->first, 2);
+    QCOMPARE(table.begin()->second, 4.0);
+    QVERIFY(table.Find(5) != nullptr);
+    QCOMPARE(*table.Find(7), 1.0);
+    QVERIFY(table.Find(3) == nullptr);
+}
+
+void TestItem::testPseudoMods() {
+
+    // Make sure the mods that make up the pseudo resistances are known.
+    AddStatTranslations(std::vector<QString>{
+        "+#% to Fire Resistance",
+        "+#% to Cold Resistance",
+        "+#% to Fire and Cold Resistances" });
+    InitModList();
+
+    const auto add = [](const QByteArray& mod, ModTable* table) {
+        AddModToTable(mod.constData(), mod.size(), table);
+    };
+
+    ModTable table;
+    add("+20% to Fire Resistance", &table);
+    add("+12% to Fire and Cold Resistances", &table);
+
+    // Each resistance is added to every pseudo total it counts towards.
+    const ModId total_fire = GetModId("(pseudo) (total) +#% to Fire Resistance");
+    const ModId total_cold = GetModId("(pseudo) (total) +#% to Cold Resistance");
+    QVERIFY(total_fire >= 0);
+    QVERIFY(total_cold >= 0);
+    QVERIFY(table.Find(total_fire) != nullptr);
+    QVERIFY(table.Find(total_cold) != nullptr);
+    QCOMPARE(*table.Find(total_fire), 32.0);
+    QCOMPARE(*table.Find(total_cold), 12.0);
+}
+
 void TestItem::testDivCardCategory() {
     const Item item = parseItem(kCategoriesItemCard);
     const QString category = item.category();
@@ -27,6 +27,9 @@ class TestItem : public QObject {
     Q_OBJECT
 private slots:
     void testBasicParsing();
+    void testModMatcher();
+    void testModTable();
+    void testPseudoMods();
 
     void testDivCardCategory();
     void testBeltCategory();
@@ -20,16 +20,50 @@
 #include "testitemsmanager.h"
 
 #include <QTest>
+#include <QTreeView>
+
+#include <vector>
 
 #include "rapidjson/document.h"
 
 #include "buyoutmanager.h"
 #include "datastore/datastore.h"
+#include "filters.h"
 #include "item.h"
+#include "itemindex.h"
 #include "itemsmanager.h"
+#include "modlist.h"
 #include "network_info.h"
+#include "search.h"
 #include "testdata.h"
 
+namespace {
+
+    std::shared_ptr<Item> ParseItem(const char* json, const ItemLocation& location) {
+        rapidjson::Document doc;
+        doc.Parse(json);
+        return std::make_shared<Item>(doc, location);
+    }
+
+    // A filter without a search form that matches items by name.
+    class NameContainsFilter : public Filter {
+    public:
+        explicit NameContainsFilter(const QString& text) : m_text(text) {}
+        void FromForm(FilterData* data) {
+            data->text_query = m_text;
+            m_active = true;
+        }
+        void ToForm(FilterData* /* data */) {}
+        void ResetForm() { m_active = false; }
+        bool Matches(const std::shared_ptr<Item>& item, FilterData* data) {
+            return item->PrettyName().contains(data->text_query);
+        }
+    private:
+        QString m_text;
+    };
+
+}
+
 TestItemsManager::TestItemsManager(
     DataStore& data,
     ItemsManager& items_manager,
@@ -230,3 +264,219 @@ void TestItemsManager::ItemHashMigration() {
     QVERIFY2(buyout_from_mgr == buyout, "After migration: the buyout must match our data");
 
 }
+
+// Checks that an update remembers which items are new and where the
+// other items were before.
+void TestItemsManager::IndexIncrementalUpdate() {
+    ItemLocation tab(1, "1", "first");
+    auto a = std::make_shared<Item>("Item a", tab);
+    auto b = std::make_shared<Item>("Item b", tab);
+    auto c = std::make_shared<Item>("Item c", tab);
+    auto d = std::make_shared<Item>("Item d", tab);
+
+    ItemIndex index;
+    const Items before = { a, b, c };
+    index.Update(before);
+    const quint64 generation = index.generation();
+    QCOMPARE(index.added(), std::vector<size_t>({ 0, 1, 2 }));
+    QVERIFY(index.IsBuiltFrom(before));
+
+    const Items after = { b, c, d };
+    index.Update(after);
+    QCOMPARE(index.generation(), generation + 1);
+    QCOMPARE(index.added(), std::vector<size_t>({ 2 }));
+    QCOMPARE(index.previous_position(0), size_t(1));
+    QCOMPARE(index.previous_position(1), size_t(2));
+    QCOMPARE(index.previous_position(2), ItemIndex::npos);
+
+    // The index only covers the exact list it was built from.
+    QVERIFY(index.IsBuiltFrom(after));
+    QVERIFY(!index.IsBuiltFrom(before));
+    QVERIFY(!index.IsBuiltFrom({ c, b, d }));
+    QVERIFY(!index.IsBuiltFrom({ b, c }));
+
+    index.Clear();
+    QCOMPARE(index.size(), size_t(0));
+    QCOMPARE(index.generation(), generation + 2);
+}
+
+// Checks mod lookups by value range, including mods without a value,
+// before and after an item is removed.
+void TestItemsManager::IndexFindMod() {
+    AddStatTranslations(std::vector<QString>{
+        "+#% to Fire Resistance",
+        "Cannot be Frozen" });
+    InitModList();
+
+    const ItemLocation tab(1, "1", "first");
+    auto fire10 = ParseItem(R"({"typeLine": "Ring", "explicitMods": ["+10% to Fire Resistance"]})", tab);
+    auto fire20 = ParseItem(R"({"typeLine": "Ring", "explicitMods": ["+20% to Fire Resistance"]})", tab);
+    auto frozen = ParseItem(R"({"typeLine": "Ring", "explicitMods": ["Cannot be Frozen"]})", tab);
+    auto fire30 = ParseItem(R"({"typeLine": "Ring", "explicitMods": ["+30% to Fire Resistance"]})", tab);
+
+    ItemIndex index;
+    index.Update({ fire10, fire20, frozen, fire30 });
+
+    const QString fire = "+#% to Fire Resistance";
+    QCOMPARE(index.FindMod(ModFilterData(fire, 15, 25, true, true)), std::vector<size_t>({ 1 }));
+    QCOMPARE(index.FindMod(ModFilterData(fire, 15, 0, true, false)), std::vector<size_t>({ 1, 3 }));
+    QCOMPARE(index.FindMod(ModFilterData(fire, 0, 20, false, true)), std::vector<size_t>({ 0, 1 }));
+    QCOMPARE(index.FindMod(ModFilterData(fire, 0, 0, false, false)), std::vector<size_t>({ 0, 1, 3 }));
+
+    // A mod without a value matches any range.
+    QCOMPARE(index.FindMod(ModFilterData("Cannot be Frozen", 10, 20, true, true)), std::vector<size_t>({ 2 }));
+
+    // Unknown mods don't match anything.
+    QVERIFY(index.FindMod(ModFilterData("Not a real mod", 0, 0, false, false)).empty());
+
+    // Removing an item drops its postings and moves the later items.
+    index.Update({ fire10, frozen, fire30 });
+    QVERIFY(index.FindMod(ModFilterData(fire, 15, 25, true, true)).empty());
+    QCOMPARE(index.FindMod(ModFilterData(fire, 15, 0, true, false)), std::vector<size_t>({ 2 }));
+    QCOMPARE(index.FindMod(ModFilterData("Cannot be Frozen", 0, 0, false, false)), std::vector<size_t>({ 1 }));
+}
+
+// Checks name lookups that are too short for the trigram index as well as
+// those that use it.
+void TestItemsManager::IndexFindName() {
+    const ItemLocation tab(1, "1", "first");
+    auto fire_ring = std::make_shared<Item>("Fire Ring", tab);
+    auto ice_ring = std::make_shared<Item>("Ice Ring", tab);
+    auto firestorm = std::make_shared<Item>("Firestorm", tab);
+
+    ItemIndex index;
+    index.Update({ fire_ring, ice_ring, firestorm });
+
+    QCOMPARE(index.FindName(""), std::vector<size_t>({ 0, 1, 2 }));
+
+    // Short queries scan the names.
+    QCOMPARE(index.FindName("fi"), std::vector<size_t>({ 0, 2 }));
+    QCOMPARE(index.FindName("R"), std::vector<size_t>({ 0, 1, 2 }));
+    QVERIFY(index.FindName("zz").empty());
+
+    // Longer queries use the trigram index.
+    QCOMPARE(index.FindName("FIRE"), std::vector<size_t>({ 0, 2 }));
+    QCOMPARE(index.FindName("ice r"), std::vector<size_t>({ 1 }));
+    QVERIFY(index.FindName("fire storm").empty());
+
+    // Removed items can't be found, and the others are found at their
+    // new positions.
+    index.Update({ ice_ring, firestorm });
+    QCOMPARE(index.FindName("fire"), std::vector<size_t>({ 1 }));
+    QCOMPARE(index.FindName("fi"), std::vector<size_t>({ 1 }));
+}
+
+// Checks the attribute bitmaps and how they combine.
+void TestItemsManager::IndexFlags() {
+    const ItemLocation tab(1, "1", "first");
+    auto corrupted = ParseItem(R"({"typeLine": "Ring", "identified": true, "corrupted": true, "frameType": 2})", tab);
+    auto unidentified = ParseItem(R"({"typeLine": "Ring", "identified": false, "frameType": 2})", tab);
+    auto crafted = ParseItem(R"({"typeLine": "Ring", "identified": true, "craftedMods": ["a"], "enchantMods": ["b"], "frameType": 3})", tab);
+    auto influenced = ParseItem(R"({"typeLine": "Ring", "identified": true, "influences": {"shaper": true}, "frameType": 0})", tab);
+
+    ItemIndex index;
+    index.Update({ corrupted, unidentified, crafted, influenced });
+
+    using Flag = ItemIndex::Flag;
+    QCOMPARE(index.FindFlag(Flag::Corrupted).Positions(), std::vector<size_t>({ 0 }));
+    QCOMPARE(index.FindFlag(Flag::Unidentified).Positions(), std::vector<size_t>({ 1 }));
+    QCOMPARE(index.FindFlag(Flag::Crafted).Positions(), std::vector<size_t>({ 2 }));
+    QCOMPARE(index.FindFlag(Flag::Enchanted).Positions(), std::vector<size_t>({ 2 }));
+    QCOMPARE(index.FindFlag(Flag::Influenced).Positions(), std::vector<size_t>({ 3 }));
+    QCOMPARE(index.FindFrameType(2).Positions(), std::vector<size_t>({ 0, 1 }));
+    QCOMPARE(index.FindFrameType(3).Positions(), std::vector<size_t>({ 2 }));
+    QVERIFY(index.FindFrameType(9).Positions().empty());
+
+    ItemBitmap bitmap = index.FindFlag(Flag::Corrupted);
+    bitmap |= index.FindFlag(Flag::Crafted);
+    QCOMPARE(bitmap.Positions(), std::vector<size_t>({ 0, 2 }));
+    bitmap &= index.FindFrameType(2);
+    QCOMPARE(bitmap.Positions(), std::vector<size_t>({ 0 }));
+
+    // The bitmaps follow the items to their new positions.
+    index.Update({ influenced, corrupted });
+    QCOMPARE(index.FindFlag(Flag::Corrupted).Positions(), std::vector<size_t>({ 1 }));
+    QCOMPARE(index.FindFlag(Flag::Influenced).Positions(), std::vector<size_t>({ 0 }));
+    QVERIFY(index.FindFlag(Flag::Crafted).Positions().empty());
+}
+
+// Checks that tabs are numbered in location order, and that updates
+// report which tabs they changed.
+void TestItemsManager::IndexTabs() {
+    const ItemLocation first_tab(1, "1", "first");
+    const ItemLocation second_tab(2, "2", "second");
+    auto x = std::make_shared<Item>("Item x", second_tab);
+    auto y = std::make_shared<Item>("Item y", first_tab);
+    auto z = std::make_shared<Item>("Item z", second_tab);
+    auto w = std::make_shared<Item>("Item w", first_tab);
+
+    ItemIndex index;
+    const Items items = { x, y, z };
+    index.Update(items);
+    QCOMPARE(index.tabs(), std::vector<ItemLocation>({ first_tab, second_tab }));
+    QCOMPARE(index.tab(0), size_t(1));
+    QCOMPARE(index.tab(1), size_t(0));
+    QCOMPARE(index.tab(2), size_t(1));
+
+    // Items that aren't in an index are numbered the same way.
+    std::vector<ItemLocation> tabs;
+    std::vector<quint32> item_tabs;
+    ItemIndex::NumberTabs(items, tabs, item_tabs);
+    QCOMPARE(tabs, index.tabs());
+    QCOMPARE(item_tabs, std::vector<quint32>({ 1, 0, 1 }));
+
+    // Adding an item only changes its own tab.
+    index.Update({ x, y, z, w });
+    QVERIFY(index.tab_changed(0));
+    QVERIFY(!index.tab_changed(1));
+
+    // So does removing one.
+    index.Update({ y, z, w });
+    QVERIFY(!index.tab_changed(0));
+    QVERIFY(index.tab_changed(1));
+}
+
+// Checks that a search after a refresh keeps the earlier matches of items
+// that are still there, and only checks the new ones.
+void TestItemsManager::SearchIncrementalSplice() {
+    const ItemLocation first_tab(1, "1", "first");
+    const ItemLocation second_tab(2, "2", "second");
+    auto keep_a = std::make_shared<Item>("keep a", first_tab);
+    auto drop_b = std::make_shared<Item>("drop b", first_tab);
+    auto keep_c = std::make_shared<Item>("keep c", second_tab);
+    auto keep_d = std::make_shared<Item>("keep d", second_tab);
+    auto keep_e = std::make_shared<Item>("keep e", first_tab);
+
+    std::vector<std::unique_ptr<Filter>> filters;
+    filters.push_back(std::make_unique<NameContainsFilter>("keep"));
+    QTreeView view;
+    Search search(m_buyout_manager, "test", filters, &view);
+    search.FromForm();
+
+    ItemIndex index;
+    const Items before = { keep_a, drop_b, keep_c };
+    index.Update(before);
+    search.SetRefreshReason(RefreshReason::ItemsChanged);
+    search.FilterItems(before, index);
+    QCOMPARE(search.items(), Items({ keep_a, keep_c }));
+
+    // The item that didn't match moves to a position that did match before,
+    // so it would be kept if the previous positions were ignored.
+    const Items after = { keep_c, keep_d, drop_b, keep_e };
+    index.Update(after);
+    search.SetRefreshReason(RefreshReason::ItemsChanged);
+    search.FilterItems(after, index);
+    QCOMPARE(search.items(), Items({ keep_c, keep_d, keep_e }));
+
+    const auto& buckets = search.buckets();
+    QCOMPARE(buckets.size(), size_t(2));
+    QCOMPARE(buckets[0].location(), first_tab);
+    QCOMPARE(buckets[0].items(), Items({ keep_e }));
+    QCOMPARE(buckets[1].location(), second_tab);
+    QCOMPARE(buckets[1].items(), Items({ keep_c, keep_d }));
+
+    // A full search gives the same results.
+    search.SetRefreshReason(RefreshReason::SearchFormChanged);
+    search.FilterItems(after, index);
+    QCOMPARE(search.items(), Items({ keep_c, keep_d, keep_e }));
+}
@@ -43,6 +43,12 @@ private slots:
     void MoveItemBoToNoBo();
     void MoveItemBoToBo();
     void ItemHashMigration();
+    void IndexIncrementalUpdate();
+    void IndexFindMod();
+    void IndexFindName();
+    void IndexFlags();
+    void IndexTabs();
+    void SearchIncrementalSplice();
 private:
     DataStore& m_data;
     ItemsManager& m_items_manager;
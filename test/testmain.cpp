@@ -43,6 +43,8 @@
 #include "ratelimit/ratelimiter.h"
 #include "util/repoe.h"
 #include "shop.h"
+#include "testfetch.h"
+#include "testimagepack.h"
 #include "testitem.h"
 #include "testitemsmanager.h"
 #include "testshop.h"
@@ -71,7 +73,7 @@ int TestHelper::run(QNetworkAccessManager& network_manager, RePoE& repoe) {
 
     QSettings settings(tmp->fileName(), QSettings::IniFormat);
     OAuthManager oauth_manager(network_manager, *datastore);
-    RateLimiter rate_limiter(network_manager, oauth_manager, POE_API::LEGACY);
+    RateLimiter rate_limiter(network_manager, oauth_manager, *datastore, POE_API::LEGACY);
     BuyoutManager buyout_manager(*datastore);
     ItemsManager items_manager(settings, network_manager, repoe, buyout_manager, *datastore, rate_limiter);
     Shop shop(settings, network_manager, rate_limiter, *datastore, items_manager, buyout_manager);
@@ -103,6 +105,18 @@ int TestHelper::run(QNetworkAccessManager& network_manager, RePoE& repoe) {
 		QLOG_INFO() << "TestItemsManager result is" << result;
 		overall_result |= result;
 	};
+    {
+		TestImagePack image_pack_test;
+		const int result = QTest::qExec(&image_pack_test, { verbosity, "-o", "acquisition-test-image-pack.log" });
+		QLOG_INFO() << "TestImagePack result is" << result;
+		overall_result |= result;
+	};
+    {
+		TestFetch fetch_test(repoe);
+		const int result = QTest::qExec(&fetch_test, { verbosity, "-o", "acquisition-test-fetch.log" });
+		QLOG_INFO() << "TestFetch result is" << result;
+		overall_result |= result;
+	};
 	int status = (overall_result == 0) ? 0 : -1;
     emit finished(status);
     return status;